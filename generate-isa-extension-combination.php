@@ -9,6 +9,8 @@
  * Generate command: php generate-isa-extension-combination.php > platformio_isa-extension-combination_env.ini
  *
  * The list of combinations might be a bit much.
+ *
+ * Every combination is generated once per build family, so the debug and release environments stay in sync.
  */
 
 /**
@@ -82,6 +84,15 @@ $subset = [
     ]],
 ];
 
+/**
+ * List of build families with the environment name suffix and the platformio.ini section they extend.
+ *
+ * The debug family has no suffix so its environment names stay the plain ISA-string.
+ */
+$families = [
+    '' => 'common',
+    '-release' => 'release',
+];
 
 $subsetKeyCombinations = generateKeyCombinations(array_keys($subset));
 
@@ -96,14 +107,16 @@ foreach ($baseIntegerISA as $biKey => $biValue) {
             continue;
         }
 
-        print "[env:{$isa}]\n";
-        print "extends           = common\n";
-        print "build_flags       =\n";
-        print "  \${common.build_flags}\n";
-        foreach (array_merge($biValue, $uniqueValues) as $value) {
-            print "  {$value}\n";
+        foreach ($families as $suffix => $section) {
+            print "[env:{$isa}{$suffix}]\n";
+            print "extends           = {$section}\n";
+            print "build_flags       =\n";
+            print "  \${{$section}.build_flags}\n";
+            foreach (array_merge($biValue, $uniqueValues) as $value) {
+                print "  {$value}\n";
+            }
+            print "\n";
         }
-        print "\n";
     }
 }
 
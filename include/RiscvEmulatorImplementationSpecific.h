@@ -10,59 +10,153 @@ SPDX-License-Identifier: Apache-2.0
 #include <RiscvEmulatorDefine.h>
 #include <RiscvEmulatorType.h>
 
+#include "instance.h"
 #include "memory.h"
+#include "region.h"
 
 #ifndef RiscvEmulatorImplementationSpecific_H_
 #define RiscvEmulatorImplementationSpecific_H_
 
+#if (RVE_GUARDMAPPING == 1)
 /**
  * Loads bytes from emulator to RISC-V.
  *
+ * Addresses outside RAM, ROM and the devices fault, see guard.h.
+ *
  * @param address The byte address in memory.
  * @param destination The destination address to copy the data to.
  * @param length The length in bytes of the data.
  */
 static inline void RiscvEmulatorLoad(uint32_t address, void *destination, uint8_t length) {
-    if (address >= RAM_ORIGIN + RAM_LENGTH) {
-        printf("Loading from address after RAM will not work. Stopping emulation.\n");
-        pleasestop = 1;
-    } else if (address >= RAM_ORIGIN) {
-        memcpy(destination, &memory[address - RAM_ORIGIN], length);
-    } else if (address >= ROM_ORIGIN) {
-        printf("RiscvEmulatorLoad from ROM.\n");
-        uint32_t addressinfirmware = address - ROM_ORIGIN;
-        if (addressinfirmware + length >= sizeof(firmware)) {
-            printf("Loading instructions from address after ROM will not work. Stopping emulation.\n");
-            pleasestop = 1;
-            return;
-        }
-        memcpy(destination, &firmware[addressinfirmware], length);
-    } else if (address >= IO_ORIGIN) {
-        printf("Loading from IO does not work.\n");
+    if (__builtin_expect(address - instance->bus.origin < instance->bus.length, 0) &&
+        DeviceLoad(&instance->bus, instance->regions, address, destination, length)) {
+        return;
     }
+    memcpy(destination, &instance->guest[address], length);
 }
 
 /**
  * Stores bytes from RISC-V to emulator.
  *
+ * Addresses outside RAM, ROM and the devices fault, see guard.h.
+ *
  * @param address The byte address in memory.
  * @param source The source address to copy the data from.
  * @param length The length in bytes of the data.
  */
 static inline void RiscvEmulatorStore(uint32_t address, const void *source, uint8_t length) {
-    if (address >= RAM_ORIGIN + RAM_LENGTH) {
-        printf("Writing to address after RAM will not work. Stopping emulation.\n");
-        pleasestop = 1;
-    } else if (address >= RAM_ORIGIN) {
-        memcpy(&memory[address - RAM_ORIGIN], source, length);
-    } else if (address >= ROM_ORIGIN) {
-        printf("RiscvEmulatorStore to ROM.\n");
-        memcpy(&firmware[address - ROM_ORIGIN], source, length);
-    } else if (address >= IO_ORIGIN) {
-        printf("Writing to IO does not work.\n");
+    if (__builtin_expect(address - instance->bus.origin < instance->bus.length, 0) &&
+        DeviceStore(&instance->bus, instance->regions, address, source, length)) {
+        return;
     }
+    memcpy(&instance->guest[address], source, length);
+    InstanceMarkDirty(address, length);
+}
+#else
+/**
+ * Checks that an access lies inside a region of the guest address space.
+ */
+static inline uint8_t RegionContains(uint32_t origin, uint32_t regionlength, uint32_t address, uint8_t length) {
+    return address >= origin &&
+           (uint64_t)address - origin + length <= regionlength;
 }
 
+/**
+ * Loads bytes that are not in a directly mapped page.
+ */
+static inline void RegionLoadSlow(uint32_t address, void *destination, uint8_t length) {
+    const MemoryLayout_t *layout = &instance->layout;
+
+    if (DeviceLoad(&instance->bus, instance->regions, address, destination, length)) {
+        return;
+    }
+
+    if (RegionContains(layout->ramorigin, layout->ramlength, address, length)) {
+        memcpy(destination, &instance->memory[address - layout->ramorigin], length);
+    } else if (RegionContains(layout->romorigin, layout->romlength, address, length)) {
+        instance->romloads++;
+        memcpy(destination, &instance->firmware[address - layout->romorigin], length);
+    } else if ((uint64_t)address >= (uint64_t)layout->ramorigin + layout->ramlength) {
+        fprintf(instance->log, "Loading from address after RAM will not work. Stopping emulation.\n");
+        instance->pleasestop = STOP_LOADOUTOFRANGE;
+    } else if (address < IO_ORIGIN) {
+        /* Below IO nothing is mapped; the access is ignored as it always was. */
+    } else if (address < layout->romorigin &&
+               address < layout->ramorigin) {
+        fprintf(instance->log, "Loading from IO does not work.\n");
+    } else {
+        fprintf(instance->log, "Loading from 0x%08X outside RAM and ROM will not work. Stopping emulation.\n", address);
+        instance->pleasestop = STOP_LOADOUTOFRANGE;
+    }
+}
+
+/**
+ * Stores bytes that are not in a directly mapped page.
+ */
+static inline void RegionStoreSlow(uint32_t address, const void *source, uint8_t length) {
+    const MemoryLayout_t *layout = &instance->layout;
+
+    if (DeviceStore(&instance->bus, instance->regions, address, source, length)) {
+        return;
+    }
+
+    if (RegionContains(layout->ramorigin, layout->ramlength, address, length)) {
+        memcpy(&instance->memory[address - layout->ramorigin], source, length);
+        InstanceMarkDirty(address, length);
+    } else if (RegionContains(layout->romorigin, layout->romlength, address, length)) {
+        instance->romstores++;
+        memcpy(&instance->firmware[address - layout->romorigin], source, length);
+        InstanceMarkDirty(address, length);
+    } else if ((uint64_t)address >= (uint64_t)layout->ramorigin + layout->ramlength) {
+        fprintf(instance->log, "Writing to address after RAM will not work. Stopping emulation.\n");
+        instance->pleasestop = STOP_STOREOUTOFRANGE;
+    } else if (address < IO_ORIGIN) {
+        /* Below IO nothing is mapped; the access is ignored as it always was. */
+    } else if (address < layout->romorigin &&
+               address < layout->ramorigin) {
+        fprintf(instance->log, "Writing to IO does not work.\n");
+    } else {
+        fprintf(instance->log, "Writing to 0x%08X outside RAM and ROM will not work. Stopping emulation.\n", address);
+        instance->pleasestop = STOP_STOREOUTOFRANGE;
+    }
+}
+
+/**
+ * Loads bytes from emulator to RISC-V.
+ *
+ * @param address The byte address in memory.
+ * @param destination The destination address to copy the data to.
+ * @param length The length in bytes of the data.
+ */
+static inline void RiscvEmulatorLoad(uint32_t address, void *destination, uint8_t length) {
+    uintptr_t page = instance->regions->load[address >> REGION_PAGE_SHIFT];
+    if (__builtin_expect(page != 0 && (address & REGION_PAGE_MASK) + length <= REGION_PAGE_LENGTH, 1)) {
+        memcpy(destination, (const void *)(page + address), length);
+        return;
+    }
+    RegionLoadSlow(address, destination, length);
+}
+
+/**
+ * Stores bytes from RISC-V to emulator.
+ *
+ * Only RAM is mapped for stores, so every direct store marks a page of RAM dirty.
+ *
+ * @param address The byte address in memory.
+ * @param source The source address to copy the data from.
+ * @param length The length in bytes of the data.
+ */
+static inline void RiscvEmulatorStore(uint32_t address, const void *source, uint8_t length) {
+    uintptr_t page = instance->regions->store[address >> REGION_PAGE_SHIFT];
+    if (__builtin_expect(page != 0 && (address & REGION_PAGE_MASK) + length <= REGION_PAGE_LENGTH, 1)) {
+        memcpy((void *)(page + address), source, length);
+        InstanceMarkDirty(address, length);
+        return;
+    }
+    RegionStoreSlow(address, source, length);
+}
+#endif
+
 /**
  * Handles a fault where the instruction is somehow not recognized.
  *
@@ -77,8 +171,10 @@ static inline void RiscvEmulatorIllegalInstruction(RiscvEmulatorState_t *state _
     if (state->csr.mtvec.base == 0)
 #endif
     {
-        printf("There is no trap handler. Stop emulating.\n");
-        pleasestop = 1;
+        fprintf(instance->log, "There is no trap handler for the instruction at pc: 0x%08X%s. Stop emulating.\n",
+                state->programcounter,
+                SymbolsDescribe(&instance->symbols, state->programcounter));
+        instance->pleasestop = STOP_ILLEGALINSTRUCTION;
     }
 }
 
@@ -88,13 +184,14 @@ static inline void RiscvEmulatorIllegalInstruction(RiscvEmulatorState_t *state _
  */
 static inline void RiscvEmulatorUnknownCSR(RiscvEmulatorState_t *state) {
 
-    printf("Unknown or not implemented CSR. pc: 0x%08X, instruction: 0x%08X, csr: 0x%04X\n",
-           state->programcounter,
-           state->instruction.value,
-           state->instruction.itypecsr.csr);
+    fprintf(instance->log, "Unknown or not implemented CSR. pc: 0x%08X%s, instruction: 0x%08X, csr: 0x%04X\n",
+            state->programcounter,
+            SymbolsDescribe(&instance->symbols, state->programcounter),
+            state->instruction.value,
+            state->instruction.itypecsr.csr);
 
     // Requesting stop.
-    pleasestop = 1;
+    instance->pleasestop = STOP_UNKNOWNCSR;
 }
 #endif
 
@@ -103,9 +200,9 @@ static inline void RiscvEmulatorUnknownCSR(RiscvEmulatorState_t *state) {
  */
 static inline void RiscvEmulatorHandleECALL(RiscvEmulatorState_t *state) {
     if (state->reg.a7 == 93) {
-        printf("The ecall requested is exit(%u). This means we are done emulating.\n",
-               state->reg.a0);
-        pleasestop = 1;
+        fprintf(instance->log, "The ecall requested is exit(%u). This means we are done emulating.\n",
+                state->reg.a0);
+        instance->pleasestop = STOP_EXIT;
     }
 }
 
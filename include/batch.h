@@ -0,0 +1,20 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include "options.h"
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+/**
+ * Emulates the test directories of the options on worker threads. Returns 0 when every test succeeded.
+ *
+ * Every test has its own emulator instance and writes its messages to rve.log in its directory.
+ */
+int BatchRun(const Options_t *options);
+
+#endif
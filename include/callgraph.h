@@ -0,0 +1,103 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "symbols.h"
+
+#ifndef CALLGRAPH_H_
+#define CALLGRAPH_H_
+
+/**
+ * Shadow call stack that attributes executed instructions to guest functions and calls.
+ *
+ * jal, jalr, c.jal and c.jalr that write ra or t0 call the function at their target. jalr and c.jr that jump
+ * through ra or t0 without linking return to the frame of that return address. A function is known by its
+ * entry address. Every instruction counts towards the function on top of the stack (self cost) and towards
+ * every call on the stack (inclusive cost).
+ */
+
+// Deepest calls that are followed, deeper calls count towards the deepest frame.
+#define CALLGRAPH_DEPTH 4096
+
+typedef struct {
+    uint32_t function;
+    uint32_t returnaddress;
+
+    // Instruction count at the call.
+    size_t start;
+
+    // The call that made this frame, the first frame has none.
+    uint32_t caller;
+    uint32_t callsite;
+} CallgraphFrame_t;
+
+typedef struct {
+    uint8_t used;
+    uint32_t entry;
+    uint64_t self;
+} CallgraphFunction_t;
+
+typedef struct {
+    uint8_t used;
+    uint32_t caller;
+    uint32_t callsite;
+    uint32_t callee;
+    uint64_t count;
+    uint64_t inclusive;
+} CallgraphCall_t;
+
+typedef struct {
+    CallgraphFrame_t *frames;
+    size_t depth;
+
+    // Instruction count up to which self cost has been handed out.
+    size_t stamp;
+
+    // Open addressing tables, capacity is a power of two.
+    CallgraphFunction_t *functions;
+    size_t functioncount;
+    size_t functioncapacity;
+    CallgraphCall_t *calls;
+    size_t callcount;
+    size_t callcapacity;
+} Callgraph_t;
+
+/**
+ * Starts the stack with the function at entry. Returns 0 on success.
+ */
+int CallgraphInit(Callgraph_t *callgraph, uint32_t entry);
+
+/**
+ * Releases the stack and the tables.
+ */
+void CallgraphFree(Callgraph_t *callgraph);
+
+/**
+ * Follows calls and returns. Called after every instruction.
+ *
+ * @param callgraph The call graph.
+ * @param programcounter The address of the executed instruction.
+ * @param instruction The executed instruction.
+ * @param target The address of the next instruction.
+ * @param instructions Number of executed instructions, including this one.
+ */
+void CallgraphStep(Callgraph_t *callgraph, uint32_t programcounter, uint32_t instruction, uint32_t target, size_t instructions);
+
+/**
+ * Writes the call graph in callgrind format, for KCachegrind. Returns 0 on success.
+ *
+ * @param callgraph The call graph.
+ * @param path The callgrind file.
+ * @param instructions Number of executed instructions, calls still on the stack end here.
+ * @param name The name of the guest in the file.
+ * @param symbols Names of the functions, without a symbol a function is named by its address.
+ */
+int CallgraphWrite(Callgraph_t *callgraph, const char *path, size_t instructions, const char *name, SymbolTable_t *symbols);
+
+#endif
@@ -0,0 +1,68 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "instance.h"
+#include "memory.h"
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+/**
+ * Checkpoint file, the state of an instance to continue from later.
+ *
+ * A CheckpointHeader_t, the RiscvEmulatorState_t of the hart, pagecount uint32_t guest page numbers and, from the
+ * next multiple of pagelength, the contents of those pages in the same order. Only pages of RAM and ROM that were
+ * stored to are in it, the rest comes from the images of the test. The pages are aligned in the file so a restore
+ * can map them instead of reading them.
+ */
+
+#define CHECKPOINT_MAGIC   "RVECHKPT"
+#define CHECKPOINT_VERSION 2
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pagelength;
+
+    // sizeof(RiscvEmulatorState_t), the state is only readable by a build with the same extensions.
+    uint32_t statelength;
+    uint32_t pagecount;
+
+    MemoryLayout_t layout;
+
+    uint64_t loopcounter;
+
+    // The CLINT.
+    uint64_t mtimeoffset;
+    uint64_t mtimecmp;
+    uint32_t msip;
+    uint32_t reserved;
+
+    // The registers of the UART and how far its input was received.
+    UartState_t uart;
+} CheckpointHeader_t;
+
+/**
+ * Writes the hart, the CLINT, the UART and the dirty pages of the current instance. Returns 0 on success.
+ */
+int CheckpointWrite(const char *path);
+
+/**
+ * Continues the current instance from a checkpoint. Returns 0 on success.
+ *
+ * The images of the test must be loaded already. The pages of the checkpoint are mapped copy-on-write over them
+ * and marked dirty. The UART input is moved to where it was.
+ *
+ * @param path The checkpoint file.
+ * @param log Where the reason of a failure goes.
+ */
+int CheckpointRestore(const char *path, FILE *log);
+
+#endif
@@ -0,0 +1,123 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <RiscvEmulatorTypeEmulator.h>
+
+#include "device.h"
+
+#ifndef CLINT_H_
+#define CLINT_H_
+
+/**
+ * Core-local interruptor with the register layout of the SiFive CLINT, for one hart.
+ *
+ * mtime counts retired instructions. The emulation loop only compares mtime to mtimecmp when the instruction
+ * count reaches the next event, see ClintCheck, so the timer costs nothing per instruction.
+ *
+ * Idle guests do not have to be emulated instruction by instruction. After wfi, and in a short loop that only
+ * polls mtime, mtime jumps forward to mtimecmp. Only mtime moves, loopcounter keeps counting the instructions
+ * that were emulated, so skipped time does not use up the instruction limit.
+ */
+
+#define CLINT_ORIGIN 0x02000000
+#define CLINT_LENGTH 0x10000
+
+// Registers, byte offsets from the origin.
+#define CLINT_MSIP     0x0000
+#define CLINT_MTIMECMP 0x4000
+#define CLINT_MTIME    0xBFF8
+
+// Instructions between checks while the timer interrupt cannot be taken.
+#define CLINT_POLL_INTERVAL 1024
+
+// Encoding of wfi.
+#define INSTRUCTION_WFI 0x10500073
+
+// mcause exception code of the machine timer interrupt.
+#define CLINT_MCAUSE_MTI 7
+
+// The most instructions between two reads of mtime by the same load for the loop to count as polling.
+#define CLINT_IDLE_LOOP_LENGTH 16
+
+/**
+ * What the guest looked like at the previous read of mtime, to recognize a polling loop.
+ */
+typedef struct {
+    uint8_t valid;
+    uint32_t programcounter;
+    uint32_t x[32];
+    size_t instructions;
+    size_t busaccesses;
+    size_t accesses;
+    size_t stores;
+} ClintPoll_t;
+
+typedef struct {
+    Device_t device;
+
+    // Retired instructions, mtime is this plus mtimeoffset.
+    const size_t *instructions;
+    uint64_t mtimeoffset;
+    uint64_t mtimecmp;
+    uint32_t msip;
+
+    // Instruction count at which the emulation loop calls ClintCheck, lowered when the guest changes the timer.
+    size_t *nextevent;
+
+    // For recognizing polling loops.
+    const RiscvEmulatorState_t *state;
+    const DeviceBus_t *bus;
+    const size_t *stores;
+    size_t accesses;
+    ClintPoll_t poll;
+
+    // Ticks of mtime that were skipped instead of emulated.
+    uint64_t skipped;
+} Clint_t;
+
+/**
+ * Sets up a CLINT.
+ *
+ * @param clint The CLINT.
+ * @param origin Guest address of the registers.
+ * @param instructions The retired instruction counter.
+ * @param nextevent Where the emulation loop keeps the instruction count of its next check.
+ * @param state The hart, to recognize polling loops.
+ * @param bus The bus the CLINT is on.
+ * @param stores The counter of stores of the guest to RAM and ROM, to recognize polling loops.
+ */
+void ClintInit(
+    Clint_t *clint,
+    uint32_t origin,
+    const size_t *instructions,
+    size_t *nextevent,
+    const RiscvEmulatorState_t *state,
+    const DeviceBus_t *bus,
+    const size_t *stores);
+
+/**
+ * Returns 1 when the timer can still interrupt the hart, so a guest that loops is waiting rather than stuck.
+ */
+uint8_t ClintCanWake(const Clint_t *clint, const RiscvEmulatorState_t *state);
+
+/**
+ * Lets time pass until mtimecmp, when there is a deadline ahead. Called after wfi.
+ */
+void ClintFastForward(Clint_t *clint);
+
+/**
+ * Takes the timer interrupt when it is pending and enabled. Returns the instruction count of the next check.
+ *
+ * The interrupt enters the trap handler the way the emulator enters it for an exception: mepc, mcause and
+ * mstatus are saved and the program counter is set from mtvec.
+ */
+size_t ClintCheck(Clint_t *clint, RiscvEmulatorState_t *state);
+
+#endif
@@ -0,0 +1,80 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef DELTA_H_
+#define DELTA_H_
+
+/**
+ * Delta file of dut-ram-after.bin.
+ *
+ * A DeltaHeader_t followed by pagecount records. A record is the uint32_t page index followed by the contents
+ * of that page of RAM, cut off at ramsize. Pages without a record are the same as in dut-ram.bin.
+ */
+
+#define DELTA_MAGIC   "RVEDELTA"
+#define DELTA_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t pagelength;
+    uint64_t ramsize;
+    uint64_t pagecount;
+} DeltaHeader_t;
+
+/**
+ * How dut-ram-after.bin is written.
+ */
+typedef enum {
+    // All of RAM.
+    RAMAFTER_FULL,
+
+    // Only dirty pages, to dut-ram-after.delta.
+    RAMAFTER_DELTA,
+
+    // A copy of dut-ram.bin, reflinked when the file system can, with the dirty pages written over it.
+    RAMAFTER_DIRTY,
+} RamAfter_t;
+
+/**
+ * Writes the dirty pages of RAM as a delta file. Returns the number of pages written or -1 on failure.
+ *
+ * @param path The delta file.
+ * @param memory RAM.
+ * @param ramsize Size in bytes of dut-ram.bin.
+ * @param dirty Bitmap with a bit per RAM_PAGE_LENGTH page.
+ * @param firstpage The bit of the first page of RAM.
+ */
+long DeltaWrite(const char *path, const uint8_t *memory, size_t ramsize, const uint64_t *dirty, size_t firstpage);
+
+/**
+ * Copies the original image and writes the dirty pages of RAM over the copy. Returns the number of pages written or -1 on failure.
+ *
+ * @param path The file to write.
+ * @param original The dut-ram.bin the emulation started from.
+ * @param memory RAM.
+ * @param ramsize Size in bytes of dut-ram.bin.
+ * @param dirty Bitmap with a bit per RAM_PAGE_LENGTH page.
+ * @param firstpage The bit of the first page of RAM.
+ */
+long DeltaWriteDirty(const char *path, const char *original, const uint8_t *memory, size_t ramsize, const uint64_t *dirty, size_t firstpage);
+
+/**
+ * Rebuilds the full image from an original and a delta file. Returns 0 on success.
+ *
+ * @param deltapath The delta file.
+ * @param original The dut-ram.bin the delta is relative to.
+ * @param path The full image to write.
+ * @param log Where messages go.
+ */
+int DeltaApply(const char *deltapath, const char *original, const char *path, FILE *log);
+
+#endif
@@ -0,0 +1,84 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "region.h"
+
+#ifndef DEVICE_H_
+#define DEVICE_H_
+
+// Maximum number of devices on a bus.
+#define DEVICE_CAPACITY 16
+
+typedef struct Device_s Device_t;
+
+/**
+ * Reads a register of a device.
+ *
+ * @param device The device.
+ * @param offset Byte offset from the origin of the device.
+ * @param length The length in bytes of the access.
+ */
+typedef uint32_t (*DeviceRead_t)(Device_t *device, uint32_t offset, uint8_t length);
+
+/**
+ * Writes a register of a device.
+ *
+ * @param device The device.
+ * @param offset Byte offset from the origin of the device.
+ * @param value The value, only the lowest length bytes are stored.
+ * @param length The length in bytes of the access.
+ */
+typedef void (*DeviceWrite_t)(Device_t *device, uint32_t offset, uint32_t value, uint8_t length);
+
+/**
+ * A memory-mapped device. Embed it as the first member of the state of the device.
+ */
+struct Device_s {
+    const char *name;
+
+    // Guest address and size in bytes, multiples of REGION_PAGE_LENGTH.
+    uint32_t origin;
+    uint32_t length;
+
+    DeviceRead_t read;
+    DeviceWrite_t write;
+};
+
+/**
+ * The devices of an instance.
+ */
+typedef struct {
+    Device_t *devices[DEVICE_CAPACITY];
+    uint8_t count;
+
+    // All devices lie between origin and origin + length, so one compare rules out a device.
+    uint32_t origin;
+    uint32_t length;
+
+    // Number of loads and stores handled by devices.
+    size_t accesses;
+} DeviceBus_t;
+
+/**
+ * Adds a device to the bus and to the device entries of the region table. Returns 0 on success.
+ */
+int DeviceAttach(DeviceBus_t *bus, RegionTable_t *table, Device_t *device);
+
+/**
+ * Loads from a device when there is one at the address. Returns 1 when a device handled the load.
+ */
+uint8_t DeviceLoad(DeviceBus_t *bus, const RegionTable_t *table, uint32_t address, void *destination, uint8_t length);
+
+/**
+ * Stores to a device when there is one at the address. Returns 1 when a device handled the store.
+ */
+uint8_t DeviceStore(DeviceBus_t *bus, const RegionTable_t *table, uint32_t address, const void *source, uint8_t length);
+
+#endif
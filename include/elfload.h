@@ -0,0 +1,65 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "memory.h"
+#include "symbols.h"
+
+#ifndef ELFLOAD_H_
+#define ELFLOAD_H_
+
+/**
+ * What ElfLoad found in a test ELF.
+ */
+typedef struct {
+    uint32_t entry;
+
+    // Bytes from the origin of RAM and ROM to the end of the last segment in them.
+    size_t ramsize;
+    size_t romsize;
+
+    // Bytes of instructions, the executable segments or all of ROM, the default instruction budget depends on it.
+    size_t codesize;
+
+    // begin_signature and end_signature from the symbol table.
+    uint8_t hassignature;
+    uint32_t signaturebegin;
+    uint32_t signatureend;
+} ElfImage_t;
+
+/**
+ * Loads a 32-bit little-endian RISC-V executable. Returns 0 on success.
+ *
+ * Every PT_LOAD segment is read straight from the file to its physical address in RAM or ROM, there is no copy in
+ * between. The rest of a segment stays zero, RAM and ROM come zeroed from ImageAllocate.
+ *
+ * @param path The ELF file.
+ * @param layout Where RAM and ROM are.
+ * @param memory RAM.
+ * @param firmware ROM.
+ * @param image What was loaded.
+ * @param symbols Where the symbols go, NULL when they are not needed.
+ * @param log Where the reason of a failure goes.
+ */
+int ElfLoad(
+    const char *path,
+    const MemoryLayout_t *layout,
+    uint8_t *memory,
+    uint8_t *firmware,
+    ElfImage_t *image,
+    SymbolTable_t *symbols,
+    FILE *log);
+
+/**
+ * Adds the functions and data symbols of an ELF file to a symbol table and sorts it. Returns 0 on success.
+ */
+int ElfLoadSymbols(const char *path, SymbolTable_t *symbols, FILE *log);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef GUARD_H_
+#define GUARD_H_
+
+/**
+ * Guard mapping, compiled in with RVE_GUARDMAPPING=1.
+ *
+ * The whole 32-bit guest address space is reserved as one host mapping without access. RAM and ROM are mapped at
+ * their guest addresses, so RiscvEmulatorLoad and RiscvEmulatorStore access guest[address] without any check.
+ * Accesses anywhere else fault, and the SIGSEGV handler turns the fault into a stop of the emulation.
+ */
+
+// Guest accesses are at most 8 bytes, a guard page after the 4 GiB catches the ones that wrap.
+#define GUARD_LENGTH ((size_t)1 << 32)
+
+/**
+ * Reserves the guest address space without access. Returns NULL on failure.
+ */
+uint8_t *GuardReserve(void);
+
+/**
+ * Releases a reservation of GuardReserve and everything mapped into it.
+ */
+void GuardRelease(uint8_t *guest);
+
+/**
+ * Makes guest memory readable and writable and zeroes it. Returns 0 on success.
+ *
+ * @param guest The reservation.
+ * @param address Guest address, page aligned.
+ * @param length Size in bytes, page aligned.
+ * @param hugepages Ask for transparent huge pages.
+ */
+int GuardMap(uint8_t *guest, uint32_t address, uint32_t length, uint8_t hugepages);
+
+/**
+ * Makes guest memory read-only. A store to it makes its page writable again and is counted in romstores.
+ */
+int GuardReadOnly(uint8_t *guest, uint32_t address, uint32_t length);
+
+/**
+ * Calls function with faults of the guest address space of the current instance caught.
+ *
+ * Returns 0 when function returned, or the stop reason when a guest access faulted. The guest address is then in
+ * instance->faultaddress.
+ */
+uint8_t GuardCall(void (*function)(void *argument), void *argument);
+
+#endif
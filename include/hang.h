@@ -0,0 +1,62 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <RiscvEmulatorTypeEmulator.h>
+
+#ifndef HANG_H_
+#define HANG_H_
+
+/**
+ * Recognizes a guest that loops forever without doing anything.
+ *
+ * A jump to itself is a hang right away. Other loops are compared every HANG_INTERVAL instructions at the next
+ * backward jump: when the program counter, the registers, the number of device accesses and the contents of the
+ * dirty RAM pages are the same twice in a row, the guest can only repeat itself.
+ */
+
+// Instructions between two fingerprints of a loop.
+#define HANG_INTERVAL 4096
+
+typedef struct {
+    // Set by the emulation loop every HANG_INTERVAL instructions, the next backward jump then calls HangCheck.
+    uint8_t armed;
+
+    // The fingerprint of the previous check.
+    uint8_t valid;
+    uint32_t programcounter;
+    uint32_t x[32];
+    size_t busaccesses;
+
+    // Hash of the dirty RAM pages, only taken when the rest of the fingerprint matched.
+    uint8_t hashed;
+    uint64_t memory;
+} Hang_t;
+
+/**
+ * Compares the guest to the previous check. Returns 1 when the guest is stuck.
+ *
+ * @param hang The fingerprints.
+ * @param state The hart, just after a backward jump.
+ * @param busaccesses Number of device accesses so far.
+ * @param memory RAM.
+ * @param ramlength Length of RAM in bytes.
+ * @param dirty The dirty bits of all guest pages.
+ * @param firstpage Guest page of the start of RAM.
+ */
+uint8_t HangCheck(
+    Hang_t *hang,
+    const RiscvEmulatorState_t *state,
+    size_t busaccesses,
+    const uint8_t *memory,
+    size_t ramlength,
+    const uint64_t *dirty,
+    size_t firstpage);
+
+#endif
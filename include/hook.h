@@ -0,0 +1,263 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "symbols.h"
+
+#ifndef HOOK_H_
+#define HOOK_H_
+
+/**
+ * Numeric instruction identifiers.
+ *
+ * The emulator passes the instruction as a string. The string is resolved to one of these identifiers once
+ * and after that the identifier selects the formatter.
+ * Instructions without a formatter get an identifier at or above HOOKINSTRUCTION_COUNT when first seen.
+ */
+typedef enum {
+    HOOKINSTRUCTION_UNSET = 0,
+    HOOKINSTRUCTION_UNKNOWN,
+
+    HOOKINSTRUCTION_ADD,
+    HOOKINSTRUCTION_SUB,
+    HOOKINSTRUCTION_SLL,
+    HOOKINSTRUCTION_SLT,
+    HOOKINSTRUCTION_SLTU,
+    HOOKINSTRUCTION_XOR,
+    HOOKINSTRUCTION_SRL,
+    HOOKINSTRUCTION_SRA,
+    HOOKINSTRUCTION_OR,
+    HOOKINSTRUCTION_AND,
+    HOOKINSTRUCTION_SHADD,
+    HOOKINSTRUCTION_ANDN,
+    HOOKINSTRUCTION_ORN,
+    HOOKINSTRUCTION_XNOR,
+    HOOKINSTRUCTION_MAX,
+    HOOKINSTRUCTION_MAXU,
+    HOOKINSTRUCTION_MIN,
+    HOOKINSTRUCTION_MINU,
+    HOOKINSTRUCTION_ROL,
+    HOOKINSTRUCTION_ROR,
+    HOOKINSTRUCTION_CLMUL,
+    HOOKINSTRUCTION_CLMULH,
+    HOOKINSTRUCTION_CLMULR,
+    HOOKINSTRUCTION_BCLR,
+    HOOKINSTRUCTION_BEXT,
+    HOOKINSTRUCTION_BINV,
+    HOOKINSTRUCTION_BSET,
+
+    HOOKINSTRUCTION_ADDI,
+    HOOKINSTRUCTION_SLLI,
+    HOOKINSTRUCTION_SLTI,
+    HOOKINSTRUCTION_SLTIU,
+    HOOKINSTRUCTION_XORI,
+    HOOKINSTRUCTION_SRLI,
+    HOOKINSTRUCTION_SRAI,
+    HOOKINSTRUCTION_ORI,
+    HOOKINSTRUCTION_ANDI,
+    HOOKINSTRUCTION_RORI,
+    HOOKINSTRUCTION_BCLRI,
+    HOOKINSTRUCTION_BEXTI,
+    HOOKINSTRUCTION_BINVI,
+    HOOKINSTRUCTION_BSETI,
+    HOOKINSTRUCTION_JALR,
+
+    HOOKINSTRUCTION_LB,
+    HOOKINSTRUCTION_LBU,
+    HOOKINSTRUCTION_LH,
+    HOOKINSTRUCTION_LHU,
+    HOOKINSTRUCTION_LW,
+
+    HOOKINSTRUCTION_FENCE,
+    HOOKINSTRUCTION_FENCEI,
+    HOOKINSTRUCTION_MRET,
+    HOOKINSTRUCTION_ECALL,
+    HOOKINSTRUCTION_EBREAK,
+
+    HOOKINSTRUCTION_CSRRW,
+    HOOKINSTRUCTION_CSRRS,
+    HOOKINSTRUCTION_CSRRC,
+    HOOKINSTRUCTION_CSRRWI,
+    HOOKINSTRUCTION_CSRRSI,
+    HOOKINSTRUCTION_CSRRCI,
+
+    HOOKINSTRUCTION_SB,
+    HOOKINSTRUCTION_SH,
+    HOOKINSTRUCTION_SW,
+
+    HOOKINSTRUCTION_BEQ,
+    HOOKINSTRUCTION_BNE,
+    HOOKINSTRUCTION_BGE,
+    HOOKINSTRUCTION_BGEU,
+    HOOKINSTRUCTION_BLT,
+    HOOKINSTRUCTION_BLTU,
+
+    HOOKINSTRUCTION_LUI,
+    HOOKINSTRUCTION_AUIPC,
+    HOOKINSTRUCTION_JAL,
+
+    HOOKINSTRUCTION_C_ADD,
+    HOOKINSTRUCTION_C_SUB,
+    HOOKINSTRUCTION_C_XOR,
+    HOOKINSTRUCTION_C_OR,
+    HOOKINSTRUCTION_C_AND,
+    HOOKINSTRUCTION_C_MV,
+    HOOKINSTRUCTION_C_JR,
+    HOOKINSTRUCTION_C_JALR,
+    HOOKINSTRUCTION_C_LI,
+    HOOKINSTRUCTION_C_LUI,
+    HOOKINSTRUCTION_C_ADDI,
+    HOOKINSTRUCTION_C_ADDI16SP,
+    HOOKINSTRUCTION_C_SLLI,
+    HOOKINSTRUCTION_C_SWSP,
+    HOOKINSTRUCTION_C_SW,
+    HOOKINSTRUCTION_C_ADDI4SPN,
+    HOOKINSTRUCTION_C_LWSP,
+    HOOKINSTRUCTION_C_LW,
+    HOOKINSTRUCTION_C_SRLI,
+    HOOKINSTRUCTION_C_SRAI,
+    HOOKINSTRUCTION_C_ANDI,
+    HOOKINSTRUCTION_C_BEQZ,
+    HOOKINSTRUCTION_C_BNEZ,
+    HOOKINSTRUCTION_C_JAL,
+    HOOKINSTRUCTION_C_J,
+
+    HOOKINSTRUCTION_TRAP,
+
+    HOOKINSTRUCTION_COUNT
+} HookInstruction_t;
+
+// Maximum number of instruction identifiers, including the ones handed out at runtime.
+#define HOOKINSTRUCTION_CAPACITY 512
+
+// Maximum number of distinct immediate names.
+#define HOOKIMMNAME_CAPACITY 32
+
+/**
+ * Where RiscvEmulatorHook sends the events.
+ */
+typedef enum {
+    HOOKOUTPUT_TEXT = 0,
+    HOOKOUTPUT_BINARY,
+    HOOKOUTPUT_RING,
+
+    // Only counted, see HookSetProfile.
+    HOOKOUTPUT_NONE,
+} HookOutput_t;
+
+/**
+ * Flat copy of everything a formatter prints for one hook event.
+ *
+ * Contains no pointers, so it is also the fixed-size record of the binary trace.
+ * hook must stay the first member, the binary trace uses it to tell records apart.
+ */
+typedef struct {
+    uint8_t hook;
+    uint8_t rdnum;
+    uint8_t rs1num;
+    uint8_t rs2num;
+    uint8_t immissigned;
+    uint8_t immlength;
+    uint8_t immnameid;
+    uint8_t length;
+    uint8_t compressed;
+    uint8_t mcauseinterrupt;
+    uint8_t mstatusmpp;
+    uint8_t mstatusmpie;
+    uint8_t mstatusmie;
+    uint8_t reserved;
+    uint16_t instructionid;
+    uint16_t csrnum;
+    uint32_t programcounter;
+    uint32_t programcounternext;
+    uint32_t instruction;
+    uint32_t rd;
+    uint32_t rs1;
+    uint32_t rs2;
+    uint32_t imm;
+    uint32_t memorylocation;
+    uint32_t ra;
+    uint32_t sp;
+    uint32_t csr;
+    uint32_t mtval;
+    uint32_t mepc;
+    uint32_t mcauseexceptioncode;
+} HookEvent_t;
+
+/**
+ * Selects where hook events go. Returns 0 on success.
+ *
+ * @param output The output kind.
+ * @param path The file for binary output, unused for text output.
+ */
+int HookSetOutput(HookOutput_t output, const char *path);
+
+/**
+ * Selects where text output of the calling thread goes, stdout when NULL.
+ */
+void HookSetLog(FILE *log);
+
+/**
+ * Prints the program counter of the calling thread's events as symbol+offset too, NULL turns it off.
+ */
+void HookSetSymbols(SymbolTable_t *symbols);
+
+/**
+ * Keeps only the last events in memory instead of printing them. Returns 0 on success.
+ *
+ * @param events The number of hook events to keep, about two per instruction.
+ */
+int HookSetRing(size_t events);
+
+/**
+ * Prints the events kept by HookSetRing, oldest first. Does nothing when there is no ring.
+ */
+void HookDumpRing(FILE *out);
+
+/**
+ * Counts the executed instructions by name. Returns 0 on success.
+ *
+ * Without a trace or a flight recorder nothing is printed anymore, the hook only counts.
+ */
+int HookSetProfile(void);
+
+/**
+ * Calls visit with the name and count of every instruction HookSetProfile counted.
+ */
+void HookForEachProfiled(void (*visit)(const char *name, uint64_t count, void *argument), void *argument);
+
+/**
+ * Also passes every event of the calling thread to listener, NULL turns it off.
+ *
+ * Without a trace or a flight recorder nothing is printed anymore, the hook only passes the events on.
+ */
+void HookSetListener(void (*listener)(const HookEvent_t *event, void *argument), void *argument);
+
+/**
+ * Flushes and closes the hook output.
+ */
+void HookClose(void);
+
+/**
+ * Prints one hook event in the human-readable trace format.
+ */
+void HookPrintEvent(FILE *out, const HookEvent_t *event);
+
+/**
+ * Returns the identifier of an instruction string, handing out a new one for unseen strings.
+ */
+uint16_t HookInternInstruction(const char *instruction);
+
+/**
+ * Returns the identifier of an immediate name, handing out a new one for unseen names.
+ */
+uint8_t HookInternImmediateName(const char *immname);
+
+#endif
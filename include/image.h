@@ -0,0 +1,40 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+/**
+ * Reserves zeroed memory for a RAM or ROM image. Pages are only backed when touched. Returns NULL on failure.
+ *
+ * @param length Size in bytes.
+ */
+uint8_t *ImageAllocate(size_t length);
+
+/**
+ * Releases memory of ImageAllocate, including any image mapped into it.
+ */
+void ImageFree(uint8_t *region, size_t length);
+
+/**
+ * Puts the contents of a file at the start of region. Returns 0 on success, 1 when the file cannot be opened.
+ *
+ * With map the file is mapped copy-on-write over the region instead of read: pages are read from the file when
+ * the emulator touches them, and writes stay private to the region.
+ *
+ * @param path The image file.
+ * @param region Memory of ImageAllocate.
+ * @param length Size in bytes of region, a longer file is truncated.
+ * @param map Map instead of read.
+ * @param size The number of bytes of the file in region.
+ */
+int ImageLoad(const char *path, uint8_t *region, size_t length, uint8_t map, size_t *size);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <RiscvEmulatorTypeEmulator.h>
+
+#include "callgraph.h"
+#include "clint.h"
+#include "device.h"
+#include "hang.h"
+#include "lockstep.h"
+#include "memory.h"
+#include "profile.h"
+#include "region.h"
+#include "replay.h"
+#include "symbols.h"
+#include "uart.h"
+
+#ifndef INSTANCE_H_
+#define INSTANCE_H_
+
+/**
+ * Why the emulation stops, kept in pleasestop. STOP_NONE keeps the emulation running.
+ */
+#define STOP_NONE               0
+#define STOP_EXIT               1
+#define STOP_ILLEGALINSTRUCTION 2
+#define STOP_UNKNOWNCSR         3
+#define STOP_X0                 4
+#define STOP_LOADOUTOFRANGE     5
+#define STOP_STOREOUTOFRANGE    6
+#define STOP_LOOPCOUNTER        7
+#define STOP_HANG               8
+#define STOP_DIVERGED           9
+#define STOP_BREAKPOINT         10
+
+/**
+ * Everything one emulated RISC-V needs.
+ */
+typedef struct {
+    RiscvEmulatorState_t state;
+
+    MemoryLayout_t layout;
+
+    // layout.ramlength and layout.romlength bytes, see ImageAllocate.
+    uint8_t *memory;
+    uint8_t *firmware;
+
+    // Guest pages that RiscvEmulatorLoad and RiscvEmulatorStore access directly, and where the devices are.
+    RegionTable_t *regions;
+
+    DeviceBus_t bus;
+    Uart_t uart;
+    Clint_t clint;
+    Hang_t hang;
+
+    // Set with --profile and --callgraph, while --last-write executes instructions again and while waiting for the
+    // pc of --checkpoint-pc.
+    uint8_t profiling;
+    Profile_t profile;
+    Callgraph_t callgraph;
+
+    // Guest symbols from --elf or --symbols, empty without.
+    SymbolTable_t symbols;
+
+    // The reference log of --lockstep, closed without.
+    Lockstep_t lockstep;
+
+    // Snapshots of --record, interval is 0 without.
+    Replay_t replay;
+
+    // The emulation stops with STOP_BREAKPOINT before the instruction at breakpointprogramcounter, when breakpoint
+    // is set.
+    uint8_t breakpoint;
+    uint32_t breakpointprogramcounter;
+
+    // A bit per guest page that has been stored to, REGION_PAGES bits.
+    uint64_t *dirty;
+
+#if (RVE_GUARDMAPPING == 1)
+    // The reserved guest address space, guest address 0 is guest[0].
+    uint8_t *guest;
+
+    // Guest address of the access that stopped the emulation.
+    uint32_t faultaddress;
+#endif
+
+    uint8_t pleasestop;
+    size_t loopcounter;
+
+    // Value of loopcounter at which the emulation loop checks the limit, the timer and for a hang again.
+    size_t nextevent;
+
+    // The instruction budget, loopcounter stops here.
+    size_t maxloopcounter;
+
+    // Stores of the guest to RAM and ROM.
+    size_t stores;
+
+    // Accesses to ROM that went through the slow path, see --stats.
+    size_t romloads;
+    size_t romstores;
+
+    // Where the messages of this instance go.
+    FILE *log;
+} Instance_t;
+
+/**
+ * The instance the current thread emulates.
+ *
+ * RiscvEmulatorLoad and RiscvEmulatorStore get no state from the emulator, so they find their memory through this.
+ */
+extern _Thread_local Instance_t *instance;
+
+_Static_assert(RAM_PAGE_LENGTH == REGION_PAGE_LENGTH, "Dirty pages are guest pages.");
+
+/**
+ * Marks the guest pages a store changes and counts the store.
+ *
+ * @param address The byte address in memory.
+ * @param length The length in bytes of the store.
+ */
+static inline void InstanceMarkDirty(uint32_t address, uint8_t length) {
+    instance->stores++;
+
+    uint32_t first = address >> REGION_PAGE_SHIFT;
+    uint32_t last = (uint32_t)(address + length - 1) >> REGION_PAGE_SHIFT;
+
+    instance->dirty[first / 64] |= UINT64_C(1) << (first % 64);
+    instance->dirty[last / 64] |= UINT64_C(1) << (last % 64);
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hook.h"
+#include "lockstepparse.h"
+
+#ifndef LOCKSTEP_H_
+#define LOCKSTEP_H_
+
+// Longest line of the reference log that is parsed, the rest of a longer line is skipped.
+#define LOCKSTEP_LINE_LENGTH 512
+
+// Number of reference lines before a divergence that are printed with it.
+#define LOCKSTEP_CONTEXT 8
+
+/**
+ * Compares the retired instructions with a commit log of a reference model, one instruction at a time.
+ *
+ * The log is read as it is compared, so it can come from a pipe and only a few lines are in memory. Spike
+ * --log-commits lines, core 0: 3 0x80000000 (0x00000297) x5 0x80000000, and Sail lines, [0] [M]: 0x80000000
+ * (0x00000297) auipc t0, 0 followed by x5 <- 0x80000000 and mem[0x80001000] <- 0x1, are understood. Other lines
+ * are skipped.
+ */
+typedef struct {
+    FILE *reference;
+    FILE *log;
+
+    // The line read ahead, it starts the next instruction when pending is set.
+    char line[LOCKSTEP_LINE_LENGTH];
+    uint8_t pending;
+    uint64_t linenumber;
+
+    // Reference instructions before the first one at the start of the test, like the boot ROM of Spike, are skipped.
+    uint8_t synchronized;
+
+    // Set after a divergence or the end of the log, nothing is compared after that.
+    uint8_t done;
+
+    uint64_t compared;
+
+    // The last reference lines that started an instruction, oldest at contextnext once the ring is full.
+    char context[LOCKSTEP_CONTEXT][LOCKSTEP_LINE_LENGTH];
+    size_t contextnext;
+    size_t contextcount;
+
+    // The begin event of the instruction that is being compared.
+    HookEvent_t begin;
+} Lockstep_t;
+
+/**
+ * Opens the reference log. Returns 0 on success.
+ *
+ * @param path The log, - for standard input.
+ * @param log Where the divergence and the summary go.
+ */
+int LockstepOpen(Lockstep_t *lockstep, const char *path, FILE *log);
+
+/**
+ * Compares one hook event with the reference. Stops the emulation with STOP_DIVERGED at the first difference.
+ */
+void LockstepEvent(Lockstep_t *lockstep, const HookEvent_t *event);
+
+/**
+ * Prints how many instructions were compared and closes the reference log.
+ */
+void LockstepClose(Lockstep_t *lockstep);
+
+#endif
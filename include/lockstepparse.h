@@ -0,0 +1,54 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdint.h>
+
+#ifndef LOCKSTEPPARSE_H_
+#define LOCKSTEPPARSE_H_
+
+/**
+ * What one retired instruction changed, on either side.
+ */
+typedef struct {
+    uint32_t programcounter;
+    uint8_t hasrd;
+    uint8_t rdnum;
+    uint32_t rd;
+    uint8_t hasstore;
+    uint8_t length;
+    uint32_t memorylocation;
+    uint32_t value;
+} LockstepRecord_t;
+
+/**
+ * Formats of the line that starts an instruction in the reference log.
+ */
+typedef enum {
+    LOCKSTEP_FORMAT_NONE = 0,
+    LOCKSTEP_FORMAT_SPIKE,
+    LOCKSTEP_FORMAT_SAIL,
+} LockstepFormat_t;
+
+/**
+ * Recognizes the line that starts an instruction and reads its program counter. Returns the format of the line.
+ *
+ * @param writes Where the writes of a Spike line start.
+ */
+LockstepFormat_t LockstepParseStart(const char *line, uint32_t *programcounter, const char **writes);
+
+/**
+ * Reads the writes on a Spike line, like x10 0x00000001 mem 0x80001000 0x01, into record. Other registers and CSRs
+ * are skipped, a load only has an address and is no store.
+ */
+void LockstepParseSpikeWrites(const char *text, LockstepRecord_t *record);
+
+/**
+ * Reads a write line of Sail, x5 <- 0x80000000 or mem[0x80001000] <- 0x01, into record. Other lines are skipped.
+ */
+void LockstepParseSailWrite(const char *line, LockstepRecord_t *record);
+
+#endif
@@ -10,12 +10,20 @@ SPDX-License-Identifier: Apache-2.0
 #ifndef MEMORY_H_
 #define MEMORY_H_
 
-// Size in bytes.
+// Default size in bytes of RAM and of ROM.
 #define RAM_LENGTH 0x1000000
 
-uint8_t memory[RAM_LENGTH];
-uint8_t firmware[RAM_LENGTH];
-
-uint8_t pleasestop;
+// Size in bytes of the pages of RAM tracked for changes.
+#define RAM_PAGE_LENGTH 0x1000
+
+/**
+ * Where RAM and ROM are in the guest address space. Origins and lengths are multiples of RAM_PAGE_LENGTH.
+ */
+typedef struct {
+    uint32_t ramorigin;
+    uint32_t ramlength;
+    uint32_t romorigin;
+    uint32_t romlength;
+} MemoryLayout_t;
 
 #endif
@@ -0,0 +1,106 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "delta.h"
+#include "memory.h"
+
+#ifndef OPTIONS_H_
+#define OPTIONS_H_
+
+// Result of OptionsParse when --help printed the usage.
+#define OPTIONS_HELP 2
+
+/**
+ * Command line options of rve.
+ */
+typedef struct {
+    // Write the hook trace in binary form to this file instead of printing it.
+    const char *tracebinary;
+
+    // Render this binary trace file as text and exit.
+    const char *decodetrace;
+
+    // Keep this many hook events in memory and print them only when the emulation stops abnormally.
+    size_t flightrecorder;
+
+    // Where RAM and ROM are and how large they are.
+    MemoryLayout_t layout;
+
+    // Files of the UART, relative to the test directory. Without output it writes to the log.
+    const char *uartoutput;
+    const char *uartinput;
+
+    // Map dut-rom.bin and dut-ram.bin copy-on-write instead of reading them.
+    uint8_t mmap;
+
+    // Count accesses that are not plain RAM and print the counts at the end.
+    uint8_t stats;
+
+    // Files for the execution counts and the annotated disassembly, relative to the test directory.
+    const char *profile;
+    const char *profilelisting;
+
+    // File for the call graph in callgrind format, relative to the test directory.
+    const char *callgraph;
+
+    // Test ELF to load instead of dut-rom.bin, dut-ram.bin and dut-ram-signature_begin_end.txt, relative to the
+    // test directory.
+    const char *elf;
+
+    // ELF file to take the guest symbols from when the test is not loaded with elf, relative to the test directory.
+    const char *symbols;
+
+    // Write the state to this checkpoint file, relative to the test directory, after checkpointat instructions or
+    // when the hart is about to execute checkpointpc.
+    const char *checkpoint;
+    size_t checkpointat;
+    uint32_t checkpointpc;
+    uint8_t checkpointatpc;
+
+    // Commit log of a reference model to compare every retired instruction with, relative to the test directory,
+    // - for standard input.
+    const char *lockstep;
+
+    // Keep a snapshot every record instructions, 0 keeps none. After the run, print the state stepback instructions
+    // before the end and the last store to lastwrite.
+    size_t record;
+    size_t stepback;
+    uint32_t lastwrite;
+    uint8_t findlastwrite;
+
+    // Continue from this checkpoint file, relative to the test directory, instead of from the start.
+    const char *restore;
+
+    // Most instructions a test may execute, 0 allows five times the number of words in dut-rom.bin.
+    size_t maxinstructions;
+
+    // How dut-ram-after.bin is written.
+    RamAfter_t ramafter;
+
+    // Rebuild dut-ram-after.bin from dut-ram-after.delta instead of emulating.
+    uint8_t applydelta;
+
+    // Test directories given on the command line, when there are none the current directory is the test.
+    char **directories;
+    size_t directorycount;
+
+    // File with one test directory per line.
+    const char *batchlist;
+
+    // Number of tests emulated at the same time, 0 uses all processors.
+    size_t jobs;
+} Options_t;
+
+/**
+ * Parses the command line. Returns 0 on success and OPTIONS_HELP after printing the usage for --help.
+ */
+int OptionsParse(int argc, char *argv[], Options_t *options);
+
+#endif
@@ -0,0 +1,80 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "memory.h"
+#include "symbols.h"
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+// Default disassembler of --profile-listing, RVE_OBJDUMP overrides it.
+#define PROFILE_OBJDUMP "riscv64-unknown-elf-objdump"
+
+/**
+ * Number of executions of every instruction address in ROM and RAM.
+ *
+ * There is a counter for every halfword, compressed instructions can start at any of them. The counters are
+ * allocated with ImageAllocate, so only the pages of code that runs take memory.
+ */
+typedef struct {
+    // ROM is area 0, RAM is area 1.
+    uint32_t origin[2];
+    uint32_t length[2];
+    uint64_t *counts[2];
+
+    // Instructions executed outside ROM and RAM.
+    uint64_t outside;
+} Profile_t;
+
+/**
+ * Allocates the counters for a memory layout. Returns 0 on success.
+ */
+int ProfileInit(Profile_t *profile, const MemoryLayout_t *layout);
+
+/**
+ * Releases the counters.
+ */
+void ProfileFree(Profile_t *profile);
+
+/**
+ * Counts one execution of the instruction at an address.
+ */
+static inline void ProfileCount(Profile_t *profile, uint32_t address) {
+    for (uint8_t area = 0; area < 2; area++) {
+        uint32_t offset = address - profile->origin[area];
+        if (offset < profile->length[area]) {
+            profile->counts[area][offset >> 1]++;
+            return;
+        }
+    }
+    profile->outside++;
+}
+
+/**
+ * Writes the executed addresses and the instruction mix of the hook. Returns 0 on success.
+ *
+ * A path ending in .json gets JSON, any other path CSV with lines like pc,0x20000000,5,main+0x4 and
+ * mnemonic,addi,3. Addresses without a symbol leave it empty.
+ */
+int ProfileWrite(const Profile_t *profile, const char *path, SymbolTable_t *symbols);
+
+/**
+ * Writes the disassembly of the guest with the count of every instruction in front of it. Returns 0 on success.
+ *
+ * @param profile The counts.
+ * @param path The listing file.
+ * @param rompath The ROM image or ELF file to disassemble, with objdump of RVE_OBJDUMP or else PROFILE_OBJDUMP.
+ * @param elf rompath is an ELF file.
+ * @param log Where problems are reported.
+ */
+int ProfileWriteListing(const Profile_t *profile, const char *path, const char *rompath, uint8_t elf, FILE *log);
+
+#endif
@@ -0,0 +1,65 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef REGION_H_
+#define REGION_H_
+
+/**
+ * Page-granular map of the 32-bit guest address space.
+ *
+ * An entry holds the host address of the page minus the guest address of the page, so the host address of a
+ * guest byte is the entry plus the guest address. Entry 0 sends the access to the slow path, which handles
+ * everything that is not plain memory.
+ *
+ * The slow path finds memory-mapped devices through the device entry of a page, the device number plus one.
+ */
+
+#define REGION_PAGE_SHIFT  12
+#define REGION_PAGE_LENGTH (UINT32_C(1) << REGION_PAGE_SHIFT)
+#define REGION_PAGE_MASK   (REGION_PAGE_LENGTH - 1)
+#define REGION_PAGES       (UINT32_C(1) << (32 - REGION_PAGE_SHIFT))
+
+// Access kinds of RegionMap.
+#define REGION_LOAD  1
+#define REGION_STORE 2
+
+typedef struct {
+    uintptr_t load[REGION_PAGES];
+    uintptr_t store[REGION_PAGES];
+    uint8_t device[REGION_PAGES];
+} RegionTable_t;
+
+/**
+ * Allocates a table where every page goes to the slow path. Returns NULL on failure.
+ */
+RegionTable_t *RegionAllocate(void);
+
+/**
+ * Releases a table of RegionAllocate.
+ */
+void RegionFree(RegionTable_t *table);
+
+/**
+ * Maps guest pages directly to host memory.
+ *
+ * @param table The region table.
+ * @param address Guest address, a multiple of REGION_PAGE_LENGTH.
+ * @param host Host memory of length bytes.
+ * @param length Size in bytes, a multiple of REGION_PAGE_LENGTH.
+ * @param access REGION_LOAD, REGION_STORE or both.
+ */
+void RegionMap(RegionTable_t *table, uint32_t address, uint8_t *host, uint32_t length, uint8_t access);
+
+/**
+ * Sends guest pages to the slow path again.
+ */
+void RegionUnmap(RegionTable_t *table, uint32_t address, uint32_t length, uint8_t access);
+
+#endif
@@ -0,0 +1,136 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <RiscvEmulatorTypeEmulator.h>
+
+#include "clint.h"
+#include "hang.h"
+#include "uart.h"
+
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+// Page index of a page that has no saved version, its content is that of the base.
+#define REPLAY_BASE UINT32_MAX
+
+/**
+ * The instance at one instruction count, see ReplaySnapshot.
+ */
+typedef struct {
+    size_t loopcounter;
+    RiscvEmulatorState_t state;
+    Clint_t clint;
+    Hang_t hang;
+    size_t busaccesses;
+    size_t stores;
+    size_t nextevent;
+    UartState_t uart;
+
+    // The pages of RAM and ROM that changed since the previous snapshot, pagecount of them from firstpage on in the pages of
+    // the record.
+    size_t firstpage;
+    size_t pagecount;
+} ReplaySnapshot_t;
+
+/**
+ * A store found by ReplayLastWrite.
+ */
+typedef struct {
+    size_t loopcounter;
+    uint32_t programcounter;
+    uint32_t address;
+    uint32_t value;
+    uint8_t length;
+} ReplayStore_t;
+
+/**
+ * Snapshots of the instance every interval instructions, kept in memory.
+ *
+ * Between snapshots nothing is recorded. The instance at any instruction count after the first snapshot is found
+ * again by restoring the snapshot before it and executing the instructions in between once more.
+ */
+typedef struct {
+    size_t interval;
+
+    ReplaySnapshot_t *snapshots;
+    size_t snapshotcount;
+    size_t snapshotcapacity;
+
+    // Saved versions of pages, the page of the record and RAM_PAGE_LENGTH bytes each. The pages of the record are
+    // those of RAM followed by those of ROM.
+    uint32_t *pagenumbers;
+    uint8_t *pagedata;
+    size_t pagecount;
+    size_t pagecapacity;
+
+    // Per page the index of its last saved version or REPLAY_BASE, and the snapshot it was first seen dirty at.
+    uint32_t *latest;
+    uint32_t *firstdirty;
+
+    // RAM and ROM as they were loaded, pages past the size were zero.
+    uint8_t *base;
+    size_t basesize;
+    uint8_t *rombase;
+    size_t rombasesize;
+
+    // Per page, set while restoring.
+    uint8_t *restored;
+
+    // Set while ReplayLastWrite executes instructions again, every store to watchaddress is kept in found.
+    uint8_t watching;
+    uint32_t watchaddress;
+    uint8_t hasfound;
+    ReplayStore_t found;
+} Replay_t;
+
+/**
+ * Starts a record of the instance of the calling thread. Returns 0 on success.
+ *
+ * @param interval Instructions between snapshots.
+ * @param ramloadedsize Bytes of RAM the test loaded, RAM after them is still zero.
+ * @param romloadedsize Bytes of ROM the test loaded, ROM after them is still zero.
+ */
+int ReplayInit(Replay_t *replay, size_t interval, size_t ramloadedsize, size_t romloadedsize);
+
+/**
+ * Frees the record.
+ */
+void ReplayFree(Replay_t *replay);
+
+/**
+ * Adds a snapshot of the current instruction count. Returns 0 on success.
+ */
+int ReplaySnapshot(Replay_t *replay);
+
+/**
+ * Looks at the instruction that was just executed at programcounter for a store to the watched address.
+ */
+void ReplayWatch(Replay_t *replay, uint32_t programcounter);
+
+/**
+ * Prints the instance count instructions before the end of the run. Returns 0 on success.
+ *
+ * The run must have ended, RAM and the hart no longer hold its final state afterwards.
+ *
+ * @param end The instruction count at the end of the run.
+ */
+int ReplayStepBack(Replay_t *replay, size_t end, size_t count, FILE *log);
+
+/**
+ * Prints the last store before the end of the run that wrote the byte at address. Returns 0 on success.
+ *
+ * The run must have ended, RAM and the hart no longer hold its final state afterwards.
+ *
+ * @param end The instruction count at the end of the run, without an instruction that did not complete.
+ */
+int ReplayLastWrite(Replay_t *replay, size_t end, uint32_t address, FILE *log);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "options.h"
+
+#ifndef RUN_H_
+#define RUN_H_
+
+// Size in bytes of a path buffer.
+#define RUN_PATH_LENGTH 4096
+
+// Result of RunTest when the guest got stuck in a loop.
+#define RUN_HANG 5
+
+// Result of RunTest when the guest diverged from the reference of --lockstep.
+#define RUN_DIVERGED 6
+
+/**
+ * Emulates the test in a directory on the calling thread.
+ *
+ * Reads dut-rom.bin, dut-ram.bin and dut-ram-signature_begin_end.txt from the directory and writes
+ * dut-ram-after.bin and DUT-rve.signature back into it. Returns 0 on success, RUN_HANG when the guest got stuck
+ * and RUN_DIVERGED when it differs from the reference.
+ *
+ * @param directory The test directory.
+ * @param options The command line options.
+ * @param log Where the messages of this test go.
+ */
+int RunTest(const char *directory, const Options_t *options, FILE *log);
+
+/**
+ * Executes up to count instructions on the instance of the calling thread.
+ *
+ * Returns STOP_NONE after count instructions, else why the emulation stopped. loopcounter is then the exact number
+ * of executed instructions and the program counter that of the instruction after the last. Builds with hooks check
+ * x0 and the hook after every instruction, other builds only check x0 at the next event and before returning. An
+ * event that is due after the last instruction, such as a timer interrupt, is left for the next call.
+ */
+uint8_t RunInstructions(size_t count);
+
+/**
+ * Rebuilds dut-ram-after.bin in a directory from dut-ram.bin and dut-ram-after.delta. Returns 0 on success.
+ */
+int RunApplyDelta(const char *directory, FILE *log);
+
+/**
+ * Puts the path of a file in a test directory in path.
+ *
+ * Absolute file names and the directory "." leave the file name as is.
+ */
+void RunPath(char *path, size_t size, const char *directory, const char *name);
+
+#endif
@@ -0,0 +1,37 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdint.h>
+
+#include "memory.h"
+
+#ifndef SIGNATURE_H_
+#define SIGNATURE_H_
+
+/**
+ * Checks that the words of the signature lie inside RAM. Returns 1 when they do.
+ *
+ * @param layout Where RAM is.
+ * @param begin Address of the first word.
+ * @param end Address after the last word.
+ */
+uint8_t SignatureValid(const MemoryLayout_t *layout, uint32_t begin, uint32_t end);
+
+/**
+ * Writes the signature as one lowercase hexadecimal word per line. Returns 0 on success.
+ *
+ * The whole file is formatted in memory first and written at once.
+ *
+ * @param path The signature file.
+ * @param memory RAM.
+ * @param layout Where RAM is.
+ * @param begin Address of the first word.
+ * @param end Address after the last word.
+ */
+int SignatureWrite(const char *path, const uint8_t *memory, const MemoryLayout_t *layout, uint32_t begin, uint32_t end);
+
+#endif
@@ -0,0 +1,75 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SYMBOLS_H_
+#define SYMBOLS_H_
+
+/**
+ * Guest symbols sorted by address, to print addresses as symbol+offset.
+ *
+ * An address belongs to the symbol at or before it. The symbol of the previous lookup is kept, so following the
+ * program counter through a function does not search again.
+ */
+typedef struct {
+    uint32_t address;
+
+    // Offset of the name in names.
+    uint32_t name;
+} Symbol_t;
+
+typedef struct {
+    Symbol_t *symbols;
+    size_t count;
+    size_t capacity;
+
+    char *names;
+    size_t namelength;
+    size_t namecapacity;
+
+    // Index of the symbol of the previous lookup.
+    size_t cached;
+} SymbolTable_t;
+
+/**
+ * Adds a symbol. Returns 0 on success. SymbolsSort must be called before lookups.
+ */
+int SymbolsAdd(SymbolTable_t *table, uint32_t address, const char *name);
+
+/**
+ * Sorts the symbols by address, of symbols at the same address only the first added is kept.
+ */
+void SymbolsSort(SymbolTable_t *table);
+
+/**
+ * Releases the symbols.
+ */
+void SymbolsFree(SymbolTable_t *table);
+
+/**
+ * Returns the symbol at or before address and its distance to it, NULL when there is none.
+ */
+const char *SymbolsFind(SymbolTable_t *table, uint32_t address, uint32_t *offset);
+
+/**
+ * Writes address as name or name+0x10 to buffer. Returns 0 when there is a symbol, else buffer is empty.
+ */
+int SymbolsFormat(SymbolTable_t *table, uint32_t address, char *buffer, size_t size);
+
+/**
+ * Returns address as " <name+0x10>" for messages, or "" without a symbol.
+ *
+ * The text is in a buffer of the calling thread that the next call overwrites.
+ *
+ * @param table The symbols, NULL is allowed.
+ * @param address The guest address.
+ */
+const char *SymbolsDescribe(SymbolTable_t *table, uint32_t address);
+
+#endif
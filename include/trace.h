@@ -0,0 +1,78 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hook.h"
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/**
+ * Binary trace file.
+ *
+ * A TraceHeader_t followed by fixed-size records. A record is either a HookEvent_t or a TraceNameRecord_t,
+ * told apart by the hook member. A name record defines the string behind an identifier used by later events.
+ */
+
+#define TRACE_MAGIC   "RVETRACE"
+#define TRACE_VERSION 1
+
+// Record kinds stored in the hook member that are not hook events.
+#define TRACE_RECORD_INSTRUCTIONNAME 0xF0
+#define TRACE_RECORD_IMMNAME         0xF1
+
+// Size in bytes of the write buffer.
+#define TRACE_BUFFER_SIZE 0x400000
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordsize;
+} TraceHeader_t;
+
+typedef struct {
+    uint8_t hook;
+    uint8_t reserved;
+    uint16_t id;
+    char name[sizeof(HookEvent_t) - 4];
+} TraceNameRecord_t;
+
+/**
+ * Creates a binary trace file. Returns 0 on success.
+ *
+ * @param path The trace file.
+ * @param log Where the reason of a failure goes.
+ */
+int TraceOpen(const char *path, FILE *log);
+
+/**
+ * Appends one hook event to the binary trace.
+ */
+void TraceWriteEvent(const HookEvent_t *event);
+
+/**
+ * Appends the definition of an instruction or immediate name to the binary trace.
+ *
+ * @param kind TRACE_RECORD_INSTRUCTIONNAME or TRACE_RECORD_IMMNAME.
+ * @param id The identifier used in the events.
+ * @param name The string behind the identifier.
+ */
+void TraceWriteName(uint8_t kind, uint16_t id, const char *name);
+
+/**
+ * Flushes and closes the binary trace.
+ */
+void TraceClose(void);
+
+/**
+ * Renders a binary trace file as text, exactly like the hook prints it. Returns 0 on success.
+ */
+int TraceDecode(const char *path, FILE *out);
+
+#endif
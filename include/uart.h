@@ -0,0 +1,101 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "device.h"
+
+#ifndef UART_H_
+#define UART_H_
+
+/**
+ * UART with the registers of a 16550, one page of guest address space.
+ *
+ * Transmitted bytes are collected in a buffer that is written to the output in large blocks, when it is full
+ * and when the UART is closed. Received bytes come from an input file, without input there is never any data.
+ */
+
+// Size in bytes of the transmit buffer.
+#define UART_BUFFER_SIZE 0x10000
+
+// Registers, byte offsets from the origin.
+#define UART_RBR_THR 0
+#define UART_LCR     3
+#define UART_LSR     5
+
+// Line status bits.
+#define UART_LSR_DR   0x01
+#define UART_LSR_THRE 0x20
+#define UART_LSR_TEMT 0x40
+
+// Line control bit that selects the divisor latch.
+#define UART_LCR_DLAB 0x80
+
+typedef struct {
+    Device_t device;
+
+    FILE *output;
+    uint8_t *buffer;
+    size_t used;
+
+    FILE *input;
+    // The next received byte or EOF.
+    int received;
+
+    // Registers that only hold what the guest wrote.
+    uint8_t registers[8];
+    uint8_t divisor[2];
+} Uart_t;
+
+/**
+ * What a checkpoint or a snapshot keeps of a UART: the registers and how far the input was received.
+ */
+typedef struct {
+    uint8_t registers[8];
+    uint8_t divisor[2];
+    uint8_t reserved[2];
+
+    // The next received byte or EOF, and the position in the input after it, -1 without a known position.
+    int32_t received;
+    int64_t inputoffset;
+} UartState_t;
+
+/**
+ * Sets up a UART. Returns 0 on success.
+ *
+ * @param uart The UART.
+ * @param origin Guest address of the registers.
+ * @param output Where transmitted bytes go.
+ * @param input Where received bytes come from, or NULL.
+ */
+int UartInit(Uart_t *uart, uint32_t origin, FILE *output, FILE *input);
+
+/**
+ * Writes the transmitted bytes that are still in the buffer.
+ */
+void UartFlush(Uart_t *uart);
+
+/**
+ * Flushes and releases the buffer. The files stay open, the UART drops what is sent after this and receives until the
+ * caller closes the input.
+ */
+void UartClose(Uart_t *uart);
+
+/**
+ * Takes the registers and the input position of a UART.
+ */
+void UartSave(const Uart_t *uart, UartState_t *state);
+
+/**
+ * Puts back what UartSave took and moves the input to where it was. Returns 0 on success, 1 when the input cannot be
+ * moved there.
+ */
+int UartRestore(Uart_t *uart, const UartState_t *state);
+
+#endif
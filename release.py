@@ -0,0 +1,20 @@
+Import("env")
+
+import os
+
+# Link time optimization and -march=native also have to be given to the linker.
+env.Append(LINKFLAGS=["-O3", "-flto", "-march=native"])
+
+# Profile-guided optimization.
+#
+# RVE_PGO=generate builds an instrumented executable. Running it writes profiles to .pgo/<env>.
+# RVE_PGO=use rebuilds the executable optimized with those profiles.
+pgo = os.environ.get("RVE_PGO", "")
+profiledir = os.path.join(env.subst("$PROJECT_DIR"), ".pgo", env.subst("$PIOENV"))
+
+if pgo == "generate":
+	flags = ["-fprofile-generate=" + profiledir, "-fprofile-update=atomic"]
+	env.Append(CCFLAGS=flags, LINKFLAGS=flags)
+elif pgo == "use":
+	flags = ["-fprofile-use=" + profiledir, "-fprofile-partial-training", "-Wno-missing-profile"]
+	env.Append(CCFLAGS=flags, LINKFLAGS=flags)
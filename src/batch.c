@@ -0,0 +1,191 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "batch.h"
+#include "options.h"
+#include "run.h"
+
+/**
+ * Work shared by the worker threads.
+ *
+ * Tests are independent and about equally long, so the workers take the next test from a shared counter.
+ */
+typedef struct {
+    const Options_t *options;
+    char **directories;
+    size_t directorycount;
+    int *results;
+    atomic_size_t next;
+    pthread_mutex_t outputlock;
+} Batch_t;
+
+static void *worker(void *argument) {
+    Batch_t *batch = argument;
+
+    for (;;) {
+        size_t index = atomic_fetch_add(&batch->next, 1);
+        if (index >= batch->directorycount) {
+            break;
+        }
+
+        const char *directory = batch->directories[index];
+        char path[RUN_PATH_LENGTH];
+        RunPath(path, sizeof(path), directory, "rve.log");
+
+        FILE *log = fopen(path, "w");
+        if (log == NULL) {
+            batch->results[index] = 4;
+        } else {
+            batch->results[index] = RunTest(directory, batch->options, log);
+            fclose(log);
+        }
+
+        pthread_mutex_lock(&batch->outputlock);
+        const char *result = "failed";
+        if (batch->results[index] == 0) {
+            result = "done";
+        } else if (batch->results[index] == RUN_HANG) {
+            result = "hung";
+        } else if (batch->results[index] == RUN_DIVERGED) {
+            result = "diverged";
+        }
+        printf("%s: %s\n", directory, result);
+        fflush(stdout);
+        pthread_mutex_unlock(&batch->outputlock);
+    }
+
+    return NULL;
+}
+
+/**
+ * Appends the directories listed in a file, one per line. Returns 0 on success.
+ */
+static int readBatchList(const char *path, char ***directories, size_t *directorycount) {
+    FILE *list = fopen(path, "r");
+    if (list == NULL) {
+        printf("Cannot open %s.\n", path);
+        return 1;
+    }
+
+    char line[RUN_PATH_LENGTH];
+    while (fgets(line, sizeof(line), list) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' ||
+            line[0] == '#') {
+            continue;
+        }
+
+        char **grown = realloc(*directories, (*directorycount + 1) * sizeof(char *));
+        char *directory = strdup(line);
+        if (grown == NULL ||
+            directory == NULL) {
+            printf("Not enough memory for the batch list.\n");
+            free(directory);
+            if (grown != NULL) {
+                *directories = grown;
+            }
+            fclose(list);
+            return 1;
+        }
+        *directories = grown;
+        (*directories)[(*directorycount)++] = directory;
+    }
+
+    fclose(list);
+    return 0;
+}
+
+/**
+ * Runs the tests of the batch on jobs threads. Returns the number of failed tests.
+ */
+static size_t runWorkers(Batch_t *batch, size_t jobs) {
+    if (jobs > batch->directorycount) {
+        jobs = batch->directorycount;
+    }
+
+    pthread_t *threads = calloc(jobs, sizeof(pthread_t));
+    size_t started = 0;
+    if (threads != NULL) {
+        for (; started < jobs; started++) {
+            if (pthread_create(&threads[started], NULL, worker, batch) != 0) {
+                break;
+            }
+        }
+    }
+    if (started == 0) {
+        // Without threads this thread does the work.
+        worker(batch);
+    }
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    size_t failed = 0;
+    for (size_t i = 0; i < batch->directorycount; i++) {
+        if (batch->results[i] != 0) {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+int BatchRun(const Options_t *options) {
+    char **directories = NULL;
+    size_t listed = 0;
+    if (options->batchlist != NULL &&
+        readBatchList(options->batchlist, &directories, &listed) != 0) {
+        for (size_t i = 0; i < listed; i++) {
+            free(directories[i]);
+        }
+        free(directories);
+        return 4;
+    }
+
+    Batch_t batch = {
+        .options = options,
+        .directorycount = options->directorycount + listed,
+        .outputlock = PTHREAD_MUTEX_INITIALIZER,
+    };
+    atomic_init(&batch.next, 0);
+    batch.directories = calloc(batch.directorycount + 1, sizeof(char *));
+    batch.results = calloc(batch.directorycount + 1, sizeof(int));
+
+    int result = 4;
+    if (batch.directories == NULL ||
+        batch.results == NULL) {
+        printf("Not enough memory for the batch.\n");
+    } else {
+        memcpy(batch.directories, options->directories, options->directorycount * sizeof(char *));
+        memcpy(&batch.directories[options->directorycount], directories, listed * sizeof(char *));
+
+        size_t jobs = options->jobs;
+        if (jobs == 0) {
+            long processors = sysconf(_SC_NPROCESSORS_ONLN);
+            jobs = processors > 0 ? (size_t)processors : 1;
+        }
+
+        size_t failed = runWorkers(&batch, jobs);
+        printf("Ran %zu tests, %zu failed.\n", batch.directorycount, failed);
+        result = failed > 0 ? 1 : 0;
+    }
+
+    for (size_t i = 0; i < listed; i++) {
+        free(directories[i]);
+    }
+    free(directories);
+    free(batch.directories);
+    free(batch.results);
+    return result;
+}
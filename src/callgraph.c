@@ -0,0 +1,339 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "callgraph.h"
+
+// Initial capacity of the tables, a power of two.
+#define CALLGRAPH_TABLE_SIZE 1024
+
+#define CALLGRAPH_NONE   0
+#define CALLGRAPH_CALL   1
+#define CALLGRAPH_RETURN 2
+
+/**
+ * Tells calls and returns apart from other instructions. ra and t0 are the link registers of the calling convention.
+ */
+static inline uint8_t classify(uint32_t instruction) {
+    if ((instruction & 3) == 3) {
+        uint8_t opcode = instruction & 0x7F;
+        uint8_t rd = (instruction >> 7) & 31;
+        uint8_t rs1 = (instruction >> 15) & 31;
+
+        if (opcode == 0x6F) {
+            // jal
+            return rd == 1 || rd == 5 ? CALLGRAPH_CALL : CALLGRAPH_NONE;
+        }
+        if (opcode == 0x67) {
+            // jalr
+            if (rd == 1 || rd == 5) {
+                return CALLGRAPH_CALL;
+            }
+            return rd == 0 && (rs1 == 1 || rs1 == 5) ? CALLGRAPH_RETURN : CALLGRAPH_NONE;
+        }
+        return CALLGRAPH_NONE;
+    }
+
+    uint16_t compressed = instruction & 0xFFFF;
+    uint8_t rs1 = (compressed >> 7) & 31;
+
+    if ((compressed & 0xE003) == 0x2001) {
+        // c.jal
+        return CALLGRAPH_CALL;
+    }
+    if ((compressed & 0xF07F) == 0x9002 &&
+        rs1 != 0) {
+        // c.jalr
+        return CALLGRAPH_CALL;
+    }
+    if ((compressed & 0xF07F) == 0x8002 &&
+        (rs1 == 1 || rs1 == 5)) {
+        // c.jr
+        return CALLGRAPH_RETURN;
+    }
+    return CALLGRAPH_NONE;
+}
+
+static inline size_t slotOf(uint64_t key, size_t capacity) {
+    return (size_t)((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (capacity - 1);
+}
+
+/**
+ * Returns the function at entry, adding it when unseen. Returns NULL when out of memory.
+ */
+static CallgraphFunction_t *findFunction(Callgraph_t *callgraph, uint32_t entry) {
+    if (callgraph->functioncount * 2 >= callgraph->functioncapacity) {
+        size_t capacity = callgraph->functioncapacity * 2;
+        CallgraphFunction_t *functions = calloc(capacity, sizeof(CallgraphFunction_t));
+        if (functions == NULL) {
+            return NULL;
+        }
+        for (size_t i = 0; i < callgraph->functioncapacity; i++) {
+            if (callgraph->functions[i].used) {
+                size_t slot = slotOf(callgraph->functions[i].entry, capacity);
+                while (functions[slot].used) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                functions[slot] = callgraph->functions[i];
+            }
+        }
+        free(callgraph->functions);
+        callgraph->functions = functions;
+        callgraph->functioncapacity = capacity;
+    }
+
+    size_t slot = slotOf(entry, callgraph->functioncapacity);
+    while (callgraph->functions[slot].used) {
+        if (callgraph->functions[slot].entry == entry) {
+            return &callgraph->functions[slot];
+        }
+        slot = (slot + 1) & (callgraph->functioncapacity - 1);
+    }
+
+    callgraph->functions[slot].used = 1;
+    callgraph->functions[slot].entry = entry;
+    callgraph->functioncount++;
+    return &callgraph->functions[slot];
+}
+
+static inline uint64_t callKey(uint32_t callsite, uint32_t callee) {
+    return ((uint64_t)callsite << 32) | callee;
+}
+
+/**
+ * Returns the call from a call site to a function, adding it when unseen. Returns NULL when out of memory.
+ */
+static CallgraphCall_t *findCall(Callgraph_t *callgraph, uint32_t caller, uint32_t callsite, uint32_t callee) {
+    if (callgraph->callcount * 2 >= callgraph->callcapacity) {
+        size_t capacity = callgraph->callcapacity * 2;
+        CallgraphCall_t *calls = calloc(capacity, sizeof(CallgraphCall_t));
+        if (calls == NULL) {
+            return NULL;
+        }
+        for (size_t i = 0; i < callgraph->callcapacity; i++) {
+            if (callgraph->calls[i].used) {
+                size_t slot = slotOf(callKey(callgraph->calls[i].callsite, callgraph->calls[i].callee), capacity);
+                while (calls[slot].used) {
+                    slot = (slot + 1) & (capacity - 1);
+                }
+                calls[slot] = callgraph->calls[i];
+            }
+        }
+        free(callgraph->calls);
+        callgraph->calls = calls;
+        callgraph->callcapacity = capacity;
+    }
+
+    // The call site also tells the caller, except when the same code is entered as different functions.
+    size_t slot = slotOf(callKey(callsite, callee), callgraph->callcapacity);
+    while (callgraph->calls[slot].used) {
+        CallgraphCall_t *call = &callgraph->calls[slot];
+        if (call->callsite == callsite &&
+            call->callee == callee &&
+            call->caller == caller) {
+            return call;
+        }
+        slot = (slot + 1) & (callgraph->callcapacity - 1);
+    }
+
+    callgraph->calls[slot].used = 1;
+    callgraph->calls[slot].caller = caller;
+    callgraph->calls[slot].callsite = callsite;
+    callgraph->calls[slot].callee = callee;
+    callgraph->callcount++;
+    return &callgraph->calls[slot];
+}
+
+int CallgraphInit(Callgraph_t *callgraph, uint32_t entry) {
+    memset(callgraph, 0, sizeof(Callgraph_t));
+    callgraph->frames = calloc(CALLGRAPH_DEPTH, sizeof(CallgraphFrame_t));
+    callgraph->functions = calloc(CALLGRAPH_TABLE_SIZE, sizeof(CallgraphFunction_t));
+    callgraph->calls = calloc(CALLGRAPH_TABLE_SIZE, sizeof(CallgraphCall_t));
+    if (callgraph->frames == NULL ||
+        callgraph->functions == NULL ||
+        callgraph->calls == NULL) {
+        CallgraphFree(callgraph);
+        return 1;
+    }
+    callgraph->functioncapacity = CALLGRAPH_TABLE_SIZE;
+    callgraph->callcapacity = CALLGRAPH_TABLE_SIZE;
+
+    callgraph->frames[0].function = entry;
+    callgraph->depth = 1;
+    return findFunction(callgraph, entry) == NULL;
+}
+
+void CallgraphFree(Callgraph_t *callgraph) {
+    free(callgraph->frames);
+    free(callgraph->functions);
+    free(callgraph->calls);
+    memset(callgraph, 0, sizeof(Callgraph_t));
+}
+
+/**
+ * Hands the instructions since the previous call or return to the function on top of the stack.
+ */
+static void chargeSelf(Callgraph_t *callgraph, size_t instructions) {
+    CallgraphFunction_t *function = findFunction(callgraph, callgraph->frames[callgraph->depth - 1].function);
+    if (function != NULL) {
+        function->self += instructions - callgraph->stamp;
+    }
+    callgraph->stamp = instructions;
+}
+
+/**
+ * Ends the call of the frame on top of the stack.
+ */
+static void popFrame(Callgraph_t *callgraph, size_t instructions) {
+    const CallgraphFrame_t *frame = &callgraph->frames[--callgraph->depth];
+    CallgraphCall_t *call = findCall(callgraph, frame->caller, frame->callsite, frame->function);
+    if (call != NULL) {
+        call->inclusive += instructions - frame->start;
+    }
+}
+
+void CallgraphStep(Callgraph_t *callgraph, uint32_t programcounter, uint32_t instruction, uint32_t target, size_t instructions) {
+    switch (classify(instruction)) {
+        case CALLGRAPH_CALL: {
+            chargeSelf(callgraph, instructions);
+            if (callgraph->depth == CALLGRAPH_DEPTH) {
+                break;
+            }
+
+            uint32_t caller = callgraph->frames[callgraph->depth - 1].function;
+            CallgraphCall_t *call = findCall(callgraph, caller, programcounter, target);
+            if (call == NULL) {
+                break;
+            }
+            call->count++;
+
+            CallgraphFrame_t *frame = &callgraph->frames[callgraph->depth++];
+            frame->function = target;
+            frame->returnaddress = programcounter + ((instruction & 3) == 3 ? 4 : 2);
+            frame->start = instructions;
+            frame->caller = caller;
+            frame->callsite = programcounter;
+            findFunction(callgraph, target);
+            break;
+        }
+        case CALLGRAPH_RETURN: {
+            chargeSelf(callgraph, instructions);
+
+            // A return can skip frames, like longjmp. A return to no frame on the stack is not followed.
+            size_t depth = callgraph->depth;
+            while (depth > 1 &&
+                   callgraph->frames[depth - 1].returnaddress != target) {
+                depth--;
+            }
+            if (depth > 1) {
+                while (callgraph->depth >= depth) {
+                    popFrame(callgraph, instructions);
+                }
+            }
+            break;
+        }
+    }
+}
+
+static int compareFunctions(const void *a, const void *b) {
+    const CallgraphFunction_t *left = a;
+    const CallgraphFunction_t *right = b;
+    return (left->entry > right->entry) - (left->entry < right->entry);
+}
+
+static int compareCalls(const void *a, const void *b) {
+    const CallgraphCall_t *left = a;
+    const CallgraphCall_t *right = b;
+    if (left->caller != right->caller) {
+        return (left->caller > right->caller) - (left->caller < right->caller);
+    }
+    if (left->callsite != right->callsite) {
+        return (left->callsite > right->callsite) - (left->callsite < right->callsite);
+    }
+    return (left->callee > right->callee) - (left->callee < right->callee);
+}
+
+/**
+ * Writes the name of the function at entry.
+ */
+static void writeFunctionName(FILE *out, SymbolTable_t *symbols, uint32_t entry) {
+    char symbol[256];
+    if (SymbolsFormat(symbols, entry, symbol, sizeof(symbol)) == 0) {
+        fprintf(out, "%s\n", symbol);
+    } else {
+        fprintf(out, "0x%08X\n", entry);
+    }
+}
+
+int CallgraphWrite(Callgraph_t *callgraph, const char *path, size_t instructions, const char *name, SymbolTable_t *symbols) {
+    // Calls that did not return yet last until the end.
+    chargeSelf(callgraph, instructions);
+    while (callgraph->depth > 1) {
+        popFrame(callgraph, instructions);
+    }
+
+    // The tables sorted, functions in order of address and calls by caller.
+    CallgraphFunction_t *functions = calloc(callgraph->functioncount + 1, sizeof(CallgraphFunction_t));
+    CallgraphCall_t *calls = calloc(callgraph->callcount + 1, sizeof(CallgraphCall_t));
+    FILE *out = functions != NULL && calls != NULL ? fopen(path, "w") : NULL;
+    if (out == NULL) {
+        free(functions);
+        free(calls);
+        return 1;
+    }
+
+    size_t functioncount = 0;
+    for (size_t i = 0; i < callgraph->functioncapacity; i++) {
+        if (callgraph->functions[i].used) {
+            functions[functioncount++] = callgraph->functions[i];
+        }
+    }
+    qsort(functions, functioncount, sizeof(CallgraphFunction_t), compareFunctions);
+
+    size_t callcount = 0;
+    for (size_t i = 0; i < callgraph->callcapacity; i++) {
+        if (callgraph->calls[i].used) {
+            calls[callcount++] = callgraph->calls[i];
+        }
+    }
+    qsort(calls, callcount, sizeof(CallgraphCall_t), compareCalls);
+
+    fprintf(out, "# callgrind format\n");
+    fprintf(out, "version: 1\n");
+    fprintf(out, "creator: rve\n");
+    fprintf(out, "positions: instr\n");
+    fprintf(out, "events: Ir\n");
+    fprintf(out, "cmd: %s\n", name);
+    fprintf(out, "totals: %zu\n", instructions);
+    fprintf(out, "\nob=%s\n", name);
+
+    size_t call = 0;
+    for (size_t i = 0; i < functioncount; i++) {
+        const CallgraphFunction_t *function = &functions[i];
+        fprintf(out, "\nfn=");
+        writeFunctionName(out, symbols, function->entry);
+        fprintf(out, "0x%08X %llu\n", function->entry, (unsigned long long)function->self);
+
+        while (call < callcount &&
+               calls[call].caller < function->entry) {
+            call++;
+        }
+        for (; call < callcount && calls[call].caller == function->entry; call++) {
+            fprintf(out, "cfn=");
+            writeFunctionName(out, symbols, calls[call].callee);
+            fprintf(out, "calls=%llu 0x%08X\n", (unsigned long long)calls[call].count, calls[call].callee);
+            fprintf(out, "0x%08X %llu\n", calls[call].callsite, (unsigned long long)calls[call].inclusive);
+        }
+    }
+
+    free(functions);
+    free(calls);
+    return fclose(out) != 0;
+}
@@ -0,0 +1,230 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "checkpoint.h"
+
+/**
+ * Returns the host address of a guest page in RAM or ROM, NULL for other pages.
+ */
+static uint8_t *hostPage(uint32_t page) {
+    const MemoryLayout_t *layout = &instance->layout;
+    uint32_t address = page << REGION_PAGE_SHIFT;
+
+    if (address - layout->ramorigin < layout->ramlength) {
+        return &instance->memory[address - layout->ramorigin];
+    }
+    if (address - layout->romorigin < layout->romlength) {
+        return &instance->firmware[address - layout->romorigin];
+    }
+    return NULL;
+}
+
+/**
+ * Adds the dirty pages of an area to pages. Returns the new number of pages.
+ */
+static uint32_t collectPages(uint32_t origin, uint32_t length, uint32_t *pages, uint32_t count) {
+    uint32_t first = origin >> REGION_PAGE_SHIFT;
+    uint32_t last = first + (length >> REGION_PAGE_SHIFT);
+
+    for (uint32_t page = first; page < last; page++) {
+        if (instance->dirty[page / 64] & (UINT64_C(1) << (page % 64))) {
+            pages[count++] = page;
+        }
+    }
+    return count;
+}
+
+/**
+ * Writes all bytes at offset. Returns 0 on success.
+ */
+static int writeAt(int fd, const void *source, size_t length, off_t offset) {
+    const uint8_t *bytes = source;
+    while (length > 0) {
+        ssize_t result = pwrite(fd, bytes, length, offset);
+        if (result <= 0) {
+            return 1;
+        }
+        bytes += result;
+        length -= result;
+        offset += result;
+    }
+    return 0;
+}
+
+/**
+ * Reads all bytes at offset. Returns 0 on success.
+ */
+static int readAt(int fd, void *destination, size_t length, off_t offset) {
+    uint8_t *bytes = destination;
+    while (length > 0) {
+        ssize_t result = pread(fd, bytes, length, offset);
+        if (result <= 0) {
+            return 1;
+        }
+        bytes += result;
+        length -= result;
+        offset += result;
+    }
+    return 0;
+}
+
+/**
+ * Offset in the file of the first page.
+ */
+static inline off_t pagesOffset(uint32_t pagecount) {
+    off_t offset = sizeof(CheckpointHeader_t) + sizeof(RiscvEmulatorState_t) + (off_t)pagecount * sizeof(uint32_t);
+    return (offset + RAM_PAGE_LENGTH - 1) & ~(off_t)(RAM_PAGE_LENGTH - 1);
+}
+
+int CheckpointWrite(const char *path) {
+    const MemoryLayout_t *layout = &instance->layout;
+    uint32_t *pages = malloc(((layout->ramlength + layout->romlength) >> REGION_PAGE_SHIFT) * sizeof(uint32_t));
+    if (pages == NULL) {
+        return 1;
+    }
+    uint32_t pagecount = collectPages(layout->ramorigin, layout->ramlength, pages, 0);
+    pagecount = collectPages(layout->romorigin, layout->romlength, pages, pagecount);
+
+    CheckpointHeader_t header = {
+        .magic = CHECKPOINT_MAGIC,
+        .version = CHECKPOINT_VERSION,
+        .pagelength = RAM_PAGE_LENGTH,
+        .statelength = sizeof(RiscvEmulatorState_t),
+        .pagecount = pagecount,
+        .layout = *layout,
+        .loopcounter = instance->loopcounter,
+        .mtimeoffset = instance->clint.mtimeoffset,
+        .mtimecmp = instance->clint.mtimecmp,
+        .msip = instance->clint.msip,
+    };
+    UartSave(&instance->uart, &header.uart);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(pages);
+        return 1;
+    }
+
+    int failed = writeAt(fd, &header, sizeof(header), 0) != 0 ||
+                 writeAt(fd, &instance->state, sizeof(RiscvEmulatorState_t), sizeof(header)) != 0 ||
+                 writeAt(fd, pages, pagecount * sizeof(uint32_t), sizeof(header) + sizeof(RiscvEmulatorState_t)) != 0;
+
+    off_t offset = pagesOffset(pagecount);
+    for (uint32_t i = 0; i < pagecount && !failed; i++) {
+        failed = writeAt(fd, hostPage(pages[i]), RAM_PAGE_LENGTH, offset + (off_t)i * RAM_PAGE_LENGTH) != 0;
+    }
+
+    free(pages);
+    return close(fd) != 0 || failed;
+}
+
+/**
+ * Puts count pages that follow each other in the guest and in the file at host. Returns 0 on success.
+ */
+static int restorePages(int fd, uint8_t *host, uint32_t count, off_t offset) {
+    size_t length = (size_t)count * RAM_PAGE_LENGTH;
+
+    if ((size_t)sysconf(_SC_PAGESIZE) == RAM_PAGE_LENGTH &&
+        mmap(host, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, offset) != MAP_FAILED) {
+        return 0;
+    }
+    // Host pages of another size cannot be mapped one guest page at a time.
+    return readAt(fd, host, length, offset);
+}
+
+int CheckpointRestore(const char *path, FILE *log) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(log, "Cannot open %s.\n", path);
+        return 1;
+    }
+
+    CheckpointHeader_t header;
+    if (readAt(fd, &header, sizeof(header), 0) != 0 ||
+        memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != CHECKPOINT_VERSION ||
+        header.pagelength != RAM_PAGE_LENGTH ||
+        header.pagecount > REGION_PAGES) {
+        fprintf(log, "%s is not a checkpoint.\n", path);
+        close(fd);
+        return 1;
+    }
+    if (header.statelength != sizeof(RiscvEmulatorState_t) ||
+        memcmp(&header.layout, &instance->layout, sizeof(MemoryLayout_t)) != 0) {
+        fprintf(log, "%s is from a build with other extensions or another memory layout.\n", path);
+        close(fd);
+        return 1;
+    }
+
+    uint32_t *pages = malloc((size_t)header.pagecount * sizeof(uint32_t) + 1);
+    if (pages == NULL ||
+        readAt(fd, &instance->state, sizeof(RiscvEmulatorState_t), sizeof(header)) != 0 ||
+        readAt(fd, pages, header.pagecount * sizeof(uint32_t), sizeof(header) + sizeof(RiscvEmulatorState_t)) != 0) {
+        fprintf(log, "Cannot read %s.\n", path);
+        free(pages);
+        close(fd);
+        return 1;
+    }
+    // The page numbers index the dirty bits, so they are checked before anything is restored.
+    for (uint32_t i = 0; i < header.pagecount; i++) {
+        if (pages[i] >= REGION_PAGES || (i > 0 && pages[i] <= pages[i - 1])) {
+            fprintf(log, "%s is not a checkpoint.\n", path);
+            free(pages);
+            close(fd);
+            return 1;
+        }
+    }
+
+    // Runs of pages that are next to each other in the guest, and so in the file, are mapped at once.
+    off_t offset = pagesOffset(header.pagecount);
+    int failed = 0;
+    for (uint32_t i = 0; i < header.pagecount && !failed;) {
+        uint8_t *host = hostPage(pages[i]);
+        if (host == NULL) {
+            failed = 1;
+            break;
+        }
+
+        uint32_t run = 1;
+        while (i + run < header.pagecount &&
+               pages[i + run] == pages[i] + run &&
+               hostPage(pages[i + run]) == host + (size_t)run * RAM_PAGE_LENGTH) {
+            run++;
+        }
+
+        failed = restorePages(fd, host, run, offset + (off_t)i * RAM_PAGE_LENGTH);
+        for (uint32_t page = pages[i]; page < pages[i] + run; page++) {
+            instance->dirty[page / 64] |= UINT64_C(1) << (page % 64);
+        }
+        i += run;
+    }
+
+    free(pages);
+    close(fd);
+    if (failed) {
+        fprintf(log, "Cannot restore the pages of %s.\n", path);
+        return 1;
+    }
+
+    instance->loopcounter = header.loopcounter;
+    instance->clint.mtimeoffset = header.mtimeoffset;
+    instance->clint.mtimecmp = header.mtimecmp;
+    instance->clint.msip = header.msip;
+    if (UartRestore(&instance->uart, &header.uart) != 0) {
+        fprintf(log, "The UART input cannot be moved to where it was in %s.\n", path);
+        return 1;
+    }
+    return 0;
+}
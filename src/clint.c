@@ -0,0 +1,227 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <string.h>
+
+#if (RVE_E_HOOK == 1)
+#include <RiscvEmulatorDefineHook.h>
+#include <RiscvEmulatorTypeHook.h>
+#endif
+
+#include "clint.h"
+
+static inline uint64_t mtime(const Clint_t *clint) {
+    return *clint->instructions + clint->mtimeoffset;
+}
+
+/**
+ * Replaces the 32-bit half of a 64-bit register at offset.
+ */
+static inline uint64_t setHalf(uint64_t value, uint32_t offset, uint32_t half) {
+    if (offset & 4) {
+        return (value & UINT64_C(0x00000000FFFFFFFF)) | ((uint64_t)half << 32);
+    }
+    return (value & UINT64_C(0xFFFFFFFF00000000)) | half;
+}
+
+static inline uint32_t getHalf(uint64_t value, uint32_t offset) {
+    return offset & 4 ? value >> 32 : value;
+}
+
+uint8_t ClintCanWake(const Clint_t *clint, const RiscvEmulatorState_t *state) {
+#if (RVE_E_ZICSR == 1)
+    return clint->mtimecmp != UINT64_MAX &&
+           state->csr.mstatus.mie &&
+           state->csr.mtvec.base != 0;
+#else
+    (void)clint;
+    (void)state;
+    return 0;
+#endif
+}
+
+void ClintFastForward(Clint_t *clint) {
+    uint64_t time = mtime(clint);
+
+    // Without a deadline there is nothing to wait for.
+    if (clint->mtimecmp == UINT64_MAX ||
+        clint->mtimecmp <= time) {
+        return;
+    }
+
+    clint->skipped += clint->mtimecmp - time;
+    clint->mtimeoffset += clint->mtimecmp - time;
+    *clint->nextevent = *clint->instructions;
+}
+
+/**
+ * The register a load writes, for the load instructions that can read mtime.
+ */
+static inline uint8_t loadDestination(uint32_t instruction) {
+    switch (instruction & 3) {
+        case 0: {
+            // c.lw
+            return 8 + ((instruction >> 2) & 7);
+        }
+        case 2: {
+            // c.lwsp
+            return (instruction >> 7) & 31;
+        }
+        default: {
+            return (instruction >> 7) & 31;
+        }
+    }
+}
+
+/**
+ * Recognizes a short loop that does nothing but read mtime and skips it to the deadline.
+ *
+ * It is such a loop when the same load reads mtime again within a few instructions, no other device was accessed
+ * and nothing was stored to RAM or ROM in between, and no register changed apart from the one the load writes.
+ * Loads of RAM and ROM only matter through the registers, so skipping iterations does not change anything but
+ * time.
+ */
+static void detectPolling(Clint_t *clint) {
+    const RiscvEmulatorState_t *state = clint->state;
+    ClintPoll_t *poll = &clint->poll;
+    size_t now = *clint->instructions;
+    uint8_t rd = loadDestination(state->instruction.value);
+
+    if (poll->valid &&
+        poll->programcounter == state->programcounter &&
+        now - poll->instructions <= CLINT_IDLE_LOOP_LENGTH &&
+        clint->bus->accesses - poll->busaccesses == clint->accesses - poll->accesses &&
+        *clint->stores == poll->stores) {
+        uint8_t same = 1;
+        for (uint8_t i = 1; i < 32; i++) {
+            if (i != rd &&
+                state->reg.x[i] != poll->x[i]) {
+                same = 0;
+                break;
+            }
+        }
+        if (same) {
+            ClintFastForward(clint);
+        }
+    }
+
+    poll->valid = 1;
+    poll->programcounter = state->programcounter;
+    memcpy(poll->x, state->reg.x, sizeof(poll->x));
+    poll->instructions = now;
+    poll->busaccesses = clint->bus->accesses;
+    poll->accesses = clint->accesses;
+    poll->stores = *clint->stores;
+}
+
+static uint32_t readRegister(Device_t *device, uint32_t offset, uint8_t length __attribute__((unused))) {
+    Clint_t *clint = (Clint_t *)device;
+    clint->accesses++;
+
+    if (offset == CLINT_MSIP) {
+        return clint->msip;
+    }
+    if ((offset & ~UINT32_C(4)) == CLINT_MTIMECMP) {
+        return getHalf(clint->mtimecmp, offset);
+    }
+    if ((offset & ~UINT32_C(4)) == CLINT_MTIME) {
+        if (offset == CLINT_MTIME) {
+            detectPolling(clint);
+        }
+        return getHalf(mtime(clint), offset);
+    }
+    return 0;
+}
+
+static void writeRegister(Device_t *device, uint32_t offset, uint32_t value, uint8_t length __attribute__((unused))) {
+    Clint_t *clint = (Clint_t *)device;
+    clint->accesses++;
+
+    if (offset == CLINT_MSIP) {
+        clint->msip = value & 1;
+    } else if ((offset & ~UINT32_C(4)) == CLINT_MTIMECMP) {
+        clint->mtimecmp = setHalf(clint->mtimecmp, offset, value);
+    } else if ((offset & ~UINT32_C(4)) == CLINT_MTIME) {
+        clint->mtimeoffset = setHalf(mtime(clint), offset, value) - *clint->instructions;
+    } else {
+        return;
+    }
+
+    // The deadline moved, check again after this instruction.
+    *clint->nextevent = *clint->instructions;
+}
+
+void ClintInit(
+    Clint_t *clint,
+    uint32_t origin,
+    const size_t *instructions,
+    size_t *nextevent,
+    const RiscvEmulatorState_t *state,
+    const DeviceBus_t *bus,
+    const size_t *stores) {
+    memset(clint, 0, sizeof(Clint_t));
+
+    clint->device.name = "clint";
+    clint->device.origin = origin;
+    clint->device.length = CLINT_LENGTH;
+    clint->device.read = readRegister;
+    clint->device.write = writeRegister;
+    clint->instructions = instructions;
+    clint->nextevent = nextevent;
+    clint->state = state;
+    clint->bus = bus;
+    clint->stores = stores;
+
+    // No interrupt until the guest sets a deadline.
+    clint->mtimecmp = UINT64_MAX;
+}
+
+size_t ClintCheck(Clint_t *clint, RiscvEmulatorState_t *state) {
+    size_t now = *clint->instructions;
+    uint64_t time = mtime(clint);
+
+    if (time < clint->mtimecmp) {
+        uint64_t wait = clint->mtimecmp - time;
+        return wait > SIZE_MAX - now ? SIZE_MAX : now + wait;
+    }
+
+#if (RVE_E_ZICSR == 1)
+    // Only mstatus.MIE gates the interrupt, the emulator has no mie register.
+    if (state->csr.mstatus.mie &&
+        state->csr.mtvec.base != 0) {
+        // The trap routine of the emulator is internal to its instruction loop, the interrupt is entered the same way
+        // here.
+        state->csr.mepc = state->programcounter;
+        state->csr.mcause.interrupt = 1;
+        state->csr.mcause.exceptioncode = CLINT_MCAUSE_MTI;
+        state->csr.mtval = 0;
+        state->csr.mstatus.mpie = state->csr.mstatus.mie;
+        state->csr.mstatus.mie = 0;
+        state->csr.mstatus.mpp = 3;
+
+        uint32_t base = state->csr.mtvec.base << 2;
+        // Vectored mode jumps to the entry of the cause.
+        state->programcounternext = state->csr.mtvec.mode == 1 ? base + 4 * CLINT_MCAUSE_MTI : base;
+
+#if (RVE_E_HOOK == 1)
+        // Traces, the flight recorder and --lockstep see the trap like one of the emulator.
+        RiscvEmulatorHookContext_t context = {
+            .hook = HOOK_UNKNOWN,
+            .instruction = "_trap",
+        };
+        RiscvEmulatorHook(state, &context);
+#endif
+
+        state->programcounter = state->programcounternext;
+    }
+#else
+    (void)state;
+#endif
+
+    // Pending until the guest moves mtimecmp, which lowers nextevent.
+    return now + CLINT_POLL_INTERVAL;
+}
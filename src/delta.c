@@ -0,0 +1,286 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+// copy_file_range is Linux only.
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "delta.h"
+#include "memory.h"
+
+/**
+ * Length in bytes of a page of RAM that is part of the image.
+ */
+static inline size_t pageLength(size_t page, size_t ramsize) {
+    size_t offset = page * RAM_PAGE_LENGTH;
+    return ramsize - offset < RAM_PAGE_LENGTH ? ramsize - offset : RAM_PAGE_LENGTH;
+}
+
+/**
+ * Calls visit for every dirty page inside the image. Stops and returns -1 when visit fails, else the number of pages.
+ */
+static long forEachDirtyPage(
+    size_t ramsize,
+    const uint64_t *dirty,
+    size_t firstpage,
+    int (*visit)(size_t page, void *argument),
+    void *argument) {
+
+    size_t pages = (ramsize + RAM_PAGE_LENGTH - 1) / RAM_PAGE_LENGTH;
+    long count = 0;
+
+    for (size_t word = firstpage / 64; word * 64 < firstpage + pages; word++) {
+        uint64_t bits = dirty[word];
+        while (bits != 0) {
+            size_t bit = word * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if (bit < firstpage) {
+                continue;
+            }
+            if (bit >= firstpage + pages) {
+                break;
+            }
+            if (visit(bit - firstpage, argument) != 0) {
+                return -1;
+            }
+            count++;
+        }
+    }
+
+    return count;
+}
+
+typedef struct {
+    FILE *file;
+    const uint8_t *memory;
+    size_t ramsize;
+} DeltaWriter_t;
+
+static int writeDeltaPage(size_t page, void *argument) {
+    DeltaWriter_t *writer = argument;
+    uint32_t index = page;
+    size_t length = pageLength(page, writer->ramsize);
+
+    if (fwrite(&index, sizeof(index), 1, writer->file) != 1 ||
+        fwrite(&writer->memory[page * RAM_PAGE_LENGTH], sizeof(uint8_t), length, writer->file) != length) {
+        return 1;
+    }
+    return 0;
+}
+
+long DeltaWrite(const char *path, const uint8_t *memory, size_t ramsize, const uint64_t *dirty, size_t firstpage) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+
+    // The page count is filled in when it is known.
+    DeltaHeader_t header = {
+        .magic = DELTA_MAGIC,
+        .version = DELTA_VERSION,
+        .pagelength = RAM_PAGE_LENGTH,
+        .ramsize = ramsize,
+    };
+    fwrite(&header, sizeof(header), 1, file);
+
+    DeltaWriter_t writer = {
+        .file = file,
+        .memory = memory,
+        .ramsize = ramsize,
+    };
+    long count = forEachDirtyPage(ramsize, dirty, firstpage, writeDeltaPage, &writer);
+
+    if (count >= 0) {
+        header.pagecount = count;
+        if (fseek(file, 0, SEEK_SET) != 0 ||
+            fwrite(&header, sizeof(header), 1, file) != 1) {
+            count = -1;
+        }
+    }
+
+    if (fclose(file) != 0) {
+        count = -1;
+    }
+    return count;
+}
+
+/**
+ * Copies original into the empty file fd. Uses a reflink when the file system supports it.
+ */
+static int copyOriginal(int fd, const char *original) {
+    int in = open(original, O_RDONLY);
+    if (in < 0) {
+        return 1;
+    }
+
+    if (ioctl(fd, FICLONE, in) == 0) {
+        close(in);
+        return 0;
+    }
+
+    struct stat status;
+    if (fstat(in, &status) != 0) {
+        close(in);
+        return 1;
+    }
+
+    off_t left = status.st_size;
+    while (left > 0) {
+        ssize_t copied = copy_file_range(in, NULL, fd, NULL, left, 0);
+        if (copied <= 0) {
+            break;
+        }
+        left -= copied;
+    }
+
+    // Not every file system can copy in the kernel.
+    uint8_t buffer[0x10000];
+    while (left > 0) {
+        ssize_t result = read(in, buffer, sizeof(buffer));
+        if (result <= 0 ||
+            write(fd, buffer, result) != result) {
+            close(in);
+            return 1;
+        }
+        left -= result;
+    }
+
+    close(in);
+    return 0;
+}
+
+typedef struct {
+    int fd;
+    const uint8_t *memory;
+    size_t ramsize;
+} DirtyWriter_t;
+
+static int writeDirtyPage(size_t page, void *argument) {
+    DirtyWriter_t *writer = argument;
+    size_t length = pageLength(page, writer->ramsize);
+
+    if (pwrite(writer->fd, &writer->memory[page * RAM_PAGE_LENGTH], length, page * RAM_PAGE_LENGTH) != (ssize_t)length) {
+        return 1;
+    }
+    return 0;
+}
+
+long DeltaWriteDirty(const char *path, const char *original, const uint8_t *memory, size_t ramsize, const uint64_t *dirty, size_t firstpage) {
+    // Removing first keeps a reflink from sharing blocks with a previous output.
+    unlink(path);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+
+    long count = -1;
+    if (copyOriginal(fd, original) == 0 &&
+        ftruncate(fd, ramsize) == 0) {
+        DirtyWriter_t writer = {
+            .fd = fd,
+            .memory = memory,
+            .ramsize = ramsize,
+        };
+        count = forEachDirtyPage(ramsize, dirty, firstpage, writeDirtyPage, &writer);
+    }
+
+    if (close(fd) != 0) {
+        count = -1;
+    }
+    return count;
+}
+
+int DeltaApply(const char *deltapath, const char *original, const char *path, FILE *log) {
+    FILE *delta = fopen(deltapath, "rb");
+    if (delta == NULL) {
+        fprintf(log, "%s not found.\n", deltapath);
+        return 1;
+    }
+
+    DeltaHeader_t header;
+    if (fread(&header, sizeof(header), 1, delta) != 1 ||
+        memcmp(header.magic, DELTA_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != DELTA_VERSION ||
+        header.pagelength != RAM_PAGE_LENGTH ||
+        header.ramsize > UINT32_MAX) {
+        fprintf(log, "%s is not a delta written by this build.\n", deltapath);
+        fclose(delta);
+        return 2;
+    }
+
+    uint8_t *image = calloc(header.ramsize + 1, sizeof(uint8_t));
+    if (image == NULL) {
+        fprintf(log, "Not enough memory for the image.\n");
+        fclose(delta);
+        return 3;
+    }
+
+    FILE *in = fopen(original, "rb");
+    if (in == NULL) {
+        fprintf(log, "%s not found.\n", original);
+        free(image);
+        fclose(delta);
+        return 1;
+    }
+    size_t originalsize = fread(image, sizeof(uint8_t), header.ramsize, in);
+    fclose(in);
+    if (originalsize != header.ramsize) {
+        fprintf(log, "%s is %zu bytes, the delta expects %zu bytes.\n",
+                original,
+                originalsize,
+                (size_t)header.ramsize);
+    }
+
+    int result = 0;
+    for (uint64_t i = 0; i < header.pagecount; i++) {
+        uint32_t index;
+        if (fread(&index, sizeof(index), 1, delta) != 1 ||
+            (uint64_t)index * RAM_PAGE_LENGTH >= header.ramsize) {
+            result = 2;
+            break;
+        }
+        size_t length = pageLength(index, header.ramsize);
+        if (fread(&image[(size_t)index * RAM_PAGE_LENGTH], sizeof(uint8_t), length, delta) != length) {
+            result = 2;
+            break;
+        }
+    }
+    fclose(delta);
+
+    if (result != 0) {
+        fprintf(log, "%s is truncated.\n", deltapath);
+        free(image);
+        return result;
+    }
+
+    FILE *out = fopen(path, "wb");
+    if (out == NULL ||
+        fwrite(image, sizeof(uint8_t), header.ramsize, out) != header.ramsize) {
+        fprintf(log, "Writing %s failed.\n", path);
+        result = 4;
+    }
+    if (out != NULL) {
+        fclose(out);
+    }
+    free(image);
+
+    if (result == 0) {
+        fprintf(log, "Wrote %zu bytes to %s with %zu changed pages.\n",
+                (size_t)header.ramsize,
+                path,
+                (size_t)header.pagecount);
+    }
+    return result;
+}
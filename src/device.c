@@ -0,0 +1,86 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <string.h>
+
+#include "device.h"
+
+int DeviceAttach(DeviceBus_t *bus, RegionTable_t *table, Device_t *device) {
+    if (bus->count >= DEVICE_CAPACITY ||
+        device->length == 0 ||
+        (device->origin | device->length) & REGION_PAGE_MASK) {
+        return 1;
+    }
+
+    uint32_t first = device->origin >> REGION_PAGE_SHIFT;
+    uint32_t pages = device->length >> REGION_PAGE_SHIFT;
+    for (uint32_t i = 0; i < pages; i++) {
+        if (table->device[first + i] != 0) {
+            return 1;
+        }
+    }
+
+    bus->devices[bus->count++] = device;
+    for (uint32_t i = 0; i < pages; i++) {
+        table->device[first + i] = bus->count;
+    }
+
+    uint64_t end = (uint64_t)device->origin + device->length;
+    if (bus->count == 1) {
+        bus->origin = device->origin;
+        bus->length = device->length;
+    } else {
+        uint64_t busend = (uint64_t)bus->origin + bus->length;
+        if (device->origin < bus->origin) {
+            bus->origin = device->origin;
+        }
+        if (end > busend) {
+            busend = end;
+        }
+        bus->length = busend - bus->origin;
+    }
+    return 0;
+}
+
+static inline Device_t *findDevice(const DeviceBus_t *bus, const RegionTable_t *table, uint32_t address) {
+    uint8_t number = table->device[address >> REGION_PAGE_SHIFT];
+    if (number == 0) {
+        return NULL;
+    }
+    return bus->devices[number - 1];
+}
+
+uint8_t DeviceLoad(DeviceBus_t *bus, const RegionTable_t *table, uint32_t address, void *destination, uint8_t length) {
+    Device_t *device = findDevice(bus, table, address);
+    if (device == NULL) {
+        return 0;
+    }
+    bus->accesses++;
+
+    uint32_t value = 0;
+    if (device->read != NULL) {
+        value = device->read(device, address - device->origin, length);
+    }
+    // The guest is little endian, like the hosts this runs on.
+    memcpy(destination, &value, length < sizeof(value) ? length : sizeof(value));
+    return 1;
+}
+
+uint8_t DeviceStore(DeviceBus_t *bus, const RegionTable_t *table, uint32_t address, const void *source, uint8_t length) {
+    Device_t *device = findDevice(bus, table, address);
+    if (device == NULL) {
+        return 0;
+    }
+    bus->accesses++;
+
+    uint32_t value = 0;
+    memcpy(&value, source, length < sizeof(value) ? length : sizeof(value));
+    if (device->write != NULL) {
+        device->write(device, address - device->origin, value, length);
+    }
+    return 1;
+}
@@ -0,0 +1,283 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#define _DEFAULT_SOURCE
+
+#include <elf.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "elfload.h"
+
+/**
+ * Reads exactly length bytes at offset. Returns 0 on success.
+ */
+static int readAt(int fd, void *destination, size_t length, off_t offset) {
+    uint8_t *bytes = destination;
+    while (length > 0) {
+        ssize_t result = pread(fd, bytes, length, offset);
+        if (result <= 0) {
+            return 1;
+        }
+        bytes += result;
+        length -= result;
+        offset += result;
+    }
+    return 0;
+}
+
+/**
+ * Checks the ELF header. Returns 0 when rve can run the file.
+ */
+static int checkHeader(const Elf32_Ehdr *header, FILE *log) {
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) != 0) {
+        fprintf(log, "Not an ELF file.\n");
+        return 1;
+    }
+    if (header->e_ident[EI_CLASS] != ELFCLASS32 ||
+        header->e_ident[EI_DATA] != ELFDATA2LSB ||
+        header->e_machine != EM_RISCV) {
+        fprintf(log, "Not a 32-bit little-endian RISC-V ELF file.\n");
+        return 1;
+    }
+    if (header->e_type != ET_EXEC) {
+        fprintf(log, "Not an executable ELF file.\n");
+        return 1;
+    }
+    if (header->e_phentsize != sizeof(Elf32_Phdr) ||
+        (header->e_shnum != 0 && header->e_shentsize != sizeof(Elf32_Shdr))) {
+        fprintf(log, "Unexpected ELF header sizes.\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Reads the segments into RAM and ROM. Returns 0 on success.
+ */
+static int loadSegments(int fd, const Elf32_Ehdr *header, const MemoryLayout_t *layout, uint8_t *memory, uint8_t *firmware, ElfImage_t *image, FILE *log) {
+    for (uint16_t i = 0; i < header->e_phnum; i++) {
+        Elf32_Phdr segment;
+        if (readAt(fd, &segment, sizeof(segment), header->e_phoff + (off_t)i * sizeof(segment)) != 0) {
+            fprintf(log, "Cannot read program header %u.\n", i);
+            return 1;
+        }
+        if (segment.p_type != PT_LOAD ||
+            segment.p_memsz == 0) {
+            continue;
+        }
+        if (segment.p_filesz > segment.p_memsz) {
+            fprintf(log, "Segment %u is larger in the file than in memory.\n", i);
+            return 1;
+        }
+
+        // The physical address, a segment that is copied from ROM to RAM at startup belongs in ROM.
+        uint64_t ramoffset = (uint64_t)segment.p_paddr - layout->ramorigin;
+        uint64_t romoffset = (uint64_t)segment.p_paddr - layout->romorigin;
+        uint8_t *destination;
+        if (segment.p_paddr >= layout->ramorigin &&
+            ramoffset + segment.p_memsz <= layout->ramlength) {
+            destination = &memory[ramoffset];
+            if (ramoffset + segment.p_memsz > image->ramsize) {
+                image->ramsize = ramoffset + segment.p_memsz;
+            }
+        } else if (segment.p_paddr >= layout->romorigin &&
+                   romoffset + segment.p_memsz <= layout->romlength) {
+            destination = &firmware[romoffset];
+            if (romoffset + segment.p_memsz > image->romsize) {
+                image->romsize = romoffset + segment.p_memsz;
+            }
+        } else {
+            fprintf(log, "Segment %u at 0x%08X of 0x%X bytes is outside RAM and ROM.\n",
+                    i,
+                    segment.p_paddr,
+                    segment.p_memsz);
+            return 1;
+        }
+        if (segment.p_flags & PF_X) {
+            image->codesize += segment.p_memsz;
+        }
+
+        if (readAt(fd, destination, segment.p_filesz, segment.p_offset) != 0) {
+            fprintf(log, "Cannot read segment %u.\n", i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * The symbol table of an ELF file, names is terminated.
+ */
+typedef struct {
+    Elf32_Sym *symbols;
+    size_t count;
+    char *names;
+    size_t namelength;
+} ElfSymbols_t;
+
+/**
+ * Reads the first symbol table. Returns 0 when the file was readable, with or without symbols.
+ */
+static int readSymbols(int fd, const Elf32_Ehdr *header, ElfSymbols_t *table) {
+    memset(table, 0, sizeof(ElfSymbols_t));
+
+    for (uint16_t i = 0; i < header->e_shnum; i++) {
+        Elf32_Shdr symtab;
+        if (readAt(fd, &symtab, sizeof(symtab), header->e_shoff + (off_t)i * sizeof(symtab)) != 0) {
+            return 1;
+        }
+        if (symtab.sh_type != SHT_SYMTAB ||
+            symtab.sh_entsize != sizeof(Elf32_Sym)) {
+            continue;
+        }
+
+        Elf32_Shdr strtab;
+        if (symtab.sh_link >= header->e_shnum ||
+            readAt(fd, &strtab, sizeof(strtab), header->e_shoff + (off_t)symtab.sh_link * sizeof(strtab)) != 0) {
+            return 1;
+        }
+
+        table->symbols = malloc(symtab.sh_size);
+        table->names = malloc(strtab.sh_size + 1);
+        if (table->symbols == NULL ||
+            table->names == NULL ||
+            readAt(fd, table->symbols, symtab.sh_size, symtab.sh_offset) != 0 ||
+            readAt(fd, table->names, strtab.sh_size, strtab.sh_offset) != 0) {
+            free(table->symbols);
+            free(table->names);
+            memset(table, 0, sizeof(ElfSymbols_t));
+            return 1;
+        }
+        table->names[strtab.sh_size] = '\0';
+        table->count = symtab.sh_size / sizeof(Elf32_Sym);
+        table->namelength = strtab.sh_size;
+        return 0;
+    }
+    return 0;
+}
+
+/**
+ * Returns the name of a symbol, "" when it has none.
+ */
+static const char *symbolName(const ElfSymbols_t *table, const Elf32_Sym *symbol) {
+    return symbol->st_name < table->namelength ? &table->names[symbol->st_name] : "";
+}
+
+/**
+ * Looks up begin_signature and end_signature.
+ */
+static void findSignature(const ElfSymbols_t *table, ElfImage_t *image) {
+    uint8_t found = 0;
+    for (size_t i = 0; i < table->count; i++) {
+        const char *name = symbolName(table, &table->symbols[i]);
+        if (strcmp(name, "begin_signature") == 0) {
+            image->signaturebegin = table->symbols[i].st_value;
+            found |= 1;
+        } else if (strcmp(name, "end_signature") == 0) {
+            image->signatureend = table->symbols[i].st_value;
+            found |= 2;
+        }
+    }
+    image->hassignature = found == 3;
+}
+
+/**
+ * Adds the code and data symbols to the index. Global symbols go first, so they win over local ones at the same
+ * address. Returns 0 on success.
+ */
+static int indexSymbols(const ElfSymbols_t *table, SymbolTable_t *index) {
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        uint8_t global = pass == 0;
+        for (size_t i = 0; i < table->count; i++) {
+            const Elf32_Sym *symbol = &table->symbols[i];
+            uint8_t type = ELF32_ST_TYPE(symbol->st_info);
+            uint8_t bind = ELF32_ST_BIND(symbol->st_info);
+            const char *name = symbolName(table, symbol);
+
+            // Mapping symbols like $x and local labels like .L1 mean nothing to a reader.
+            if ((type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE) ||
+                symbol->st_shndx == SHN_UNDEF ||
+                symbol->st_shndx == SHN_ABS ||
+                name[0] == '\0' ||
+                name[0] == '$' ||
+                strncmp(name, ".L", 2) == 0 ||
+                (bind != STB_LOCAL) != global) {
+                continue;
+            }
+            if (SymbolsAdd(index, symbol->st_value, name) != 0) {
+                return 1;
+            }
+        }
+    }
+    SymbolsSort(index);
+    return 0;
+}
+
+int ElfLoadSymbols(const char *path, SymbolTable_t *symbols, FILE *log) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(log, "Cannot open %s.\n", path);
+        return 1;
+    }
+
+    Elf32_Ehdr header;
+    ElfSymbols_t table;
+    int result = 1;
+    if (readAt(fd, &header, sizeof(header), 0) != 0 ||
+        checkHeader(&header, log) != 0 ||
+        readSymbols(fd, &header, &table) != 0) {
+        fprintf(log, "Cannot read the symbols of %s.\n", path);
+    } else {
+        result = indexSymbols(&table, symbols);
+        free(table.symbols);
+        free(table.names);
+    }
+
+    close(fd);
+    return result;
+}
+
+int ElfLoad(
+    const char *path,
+    const MemoryLayout_t *layout,
+    uint8_t *memory,
+    uint8_t *firmware,
+    ElfImage_t *image,
+    SymbolTable_t *symbols,
+    FILE *log) {
+    memset(image, 0, sizeof(ElfImage_t));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(log, "file not found.\n");
+        return 1;
+    }
+
+    Elf32_Ehdr header;
+    int result = 1;
+    if (readAt(fd, &header, sizeof(header), 0) != 0) {
+        fprintf(log, "Cannot read the ELF header.\n");
+    } else if (checkHeader(&header, log) == 0 &&
+               loadSegments(fd, &header, layout, memory, firmware, image, log) == 0) {
+        ElfSymbols_t table;
+        if (readSymbols(fd, &header, &table) != 0) {
+            fprintf(log, "Cannot read the symbol table.\n");
+        } else {
+            findSignature(&table, image);
+            image->entry = header.e_entry;
+            result = symbols != NULL ? indexSymbols(&table, symbols) : 0;
+            free(table.symbols);
+            free(table.names);
+        }
+    }
+
+    close(fd);
+    return result;
+}
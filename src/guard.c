@@ -0,0 +1,132 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+// MAP_ANONYMOUS, MADV_HUGEPAGE and REG_ERR are not part of POSIX.
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "guard.h"
+#include "instance.h"
+
+#if (RVE_GUARDMAPPING == 1)
+
+// Where GuardCall continues after a fault, and whether it is waiting for one.
+static _Thread_local sigjmp_buf guardjump;
+static _Thread_local volatile sig_atomic_t guardactive;
+
+static pthread_once_t guardonce = PTHREAD_ONCE_INIT;
+
+// sysconf is not safe to call from a signal handler.
+static uintptr_t guardpagesize;
+
+uint8_t *GuardReserve(void) {
+    guardpagesize = sysconf(_SC_PAGESIZE);
+    void *guest = mmap(NULL, GUARD_LENGTH + guardpagesize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (guest == MAP_FAILED) {
+        return NULL;
+    }
+    return guest;
+}
+
+void GuardRelease(uint8_t *guest) {
+    if (guest != NULL) {
+        munmap(guest, GUARD_LENGTH + guardpagesize);
+    }
+}
+
+int GuardMap(uint8_t *guest, uint32_t address, uint32_t length, uint8_t hugepages) {
+    void *mapped = mmap(&guest[address], length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    if (mapped == MAP_FAILED) {
+        return 1;
+    }
+
+    if (hugepages) {
+        // Only a hint, not every kernel has transparent huge pages.
+        madvise(mapped, length, MADV_HUGEPAGE);
+    }
+    return 0;
+}
+
+int GuardReadOnly(uint8_t *guest, uint32_t address, uint32_t length) {
+    return mprotect(&guest[address], length, PROT_READ) != 0;
+}
+
+/**
+ * Turns faults inside the guest address space into stops. Other faults crash as usual.
+ */
+static void handleFault(int signal, siginfo_t *info, void *context) {
+    uint8_t *address = info->si_addr;
+
+    if (!guardactive ||
+        instance == NULL ||
+        address < instance->guest ||
+        address >= instance->guest + GUARD_LENGTH + guardpagesize) {
+        // Not ours, fault again without this handler.
+        struct sigaction action = {.sa_handler = SIG_DFL};
+        sigaction(signal, &action, NULL);
+        return;
+    }
+
+    uint32_t guestaddress = (uint32_t)(address - instance->guest);
+
+    // ROM is mapped read-only, a store to it is allowed but counted.
+    if (guestaddress >= instance->layout.romorigin &&
+        guestaddress - instance->layout.romorigin < instance->layout.romlength) {
+        uint8_t *page = (uint8_t *)((uintptr_t)address & ~(guardpagesize - 1));
+        if (mprotect(page, guardpagesize, PROT_READ | PROT_WRITE) == 0) {
+            instance->romstores++;
+            return;
+        }
+    }
+
+    uint8_t reason = STOP_LOADOUTOFRANGE;
+#if defined(__x86_64__)
+    // Bit 1 of the page fault error code is set for a write.
+    if (((ucontext_t *)context)->uc_mcontext.gregs[REG_ERR] & 2) {
+        reason = STOP_STOREOUTOFRANGE;
+    }
+#else
+    (void)context;
+#endif
+
+    instance->faultaddress = guestaddress;
+    guardactive = 0;
+    siglongjmp(guardjump, reason);
+}
+
+static void installHandler(void) {
+    struct sigaction action = {
+        .sa_sigaction = handleFault,
+        .sa_flags = SA_SIGINFO,
+    };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, NULL);
+    sigaction(SIGBUS, &action, NULL);
+}
+
+uint8_t GuardCall(void (*function)(void *argument), void *argument) {
+    pthread_once(&guardonce, installHandler);
+
+    int reason = sigsetjmp(guardjump, 1);
+    if (reason != 0) {
+        return reason;
+    }
+
+    guardactive = 1;
+    function(argument);
+    guardactive = 0;
+    return 0;
+}
+
+#endif
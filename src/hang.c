@@ -0,0 +1,67 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <string.h>
+
+#include "hang.h"
+#include "memory.h"
+
+/**
+ * Hashes the pages of RAM that have been stored to.
+ */
+static uint64_t hashMemory(const uint8_t *memory, size_t ramlength, const uint64_t *dirty, size_t firstpage) {
+    uint64_t hash = UINT64_C(0xCBF29CE484222325);
+
+    for (size_t page = 0; page < ramlength / RAM_PAGE_LENGTH; page++) {
+        size_t bit = firstpage + page;
+        if ((dirty[bit / 64] & (UINT64_C(1) << (bit % 64))) == 0) {
+            continue;
+        }
+
+        const uint8_t *contents = &memory[page * RAM_PAGE_LENGTH];
+        for (size_t offset = 0; offset < RAM_PAGE_LENGTH; offset += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, &contents[offset], sizeof(word));
+            hash = (hash ^ word ^ page) * UINT64_C(0x100000001B3);
+        }
+    }
+
+    return hash;
+}
+
+uint8_t HangCheck(
+    Hang_t *hang,
+    const RiscvEmulatorState_t *state,
+    size_t busaccesses,
+    const uint8_t *memory,
+    size_t ramlength,
+    const uint64_t *dirty,
+    size_t firstpage) {
+    hang->armed = 0;
+
+    if (hang->valid &&
+        hang->programcounter == state->programcounter &&
+        hang->busaccesses == busaccesses &&
+        memcmp(hang->x, state->reg.x, sizeof(hang->x)) == 0) {
+        // Only now is hashing the memory worth it.
+        uint64_t hash = hashMemory(memory, ramlength, dirty, firstpage);
+        if (hang->hashed &&
+            hang->memory == hash) {
+            return 1;
+        }
+        hang->hashed = 1;
+        hang->memory = hash;
+    } else {
+        hang->hashed = 0;
+    }
+
+    hang->valid = 1;
+    hang->programcounter = state->programcounter;
+    memcpy(hang->x, state->reg.x, sizeof(hang->x));
+    hang->busaccesses = busaccesses;
+    return 0;
+}
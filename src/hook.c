@@ -7,6 +7,7 @@ SPDX-License-Identifier: Apache-2.0
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <RiscvEmulatorDebug.h>
@@ -15,1164 +16,1309 @@ SPDX-License-Identifier: Apache-2.0
 #include <RiscvEmulatorTypeEmulator.h>
 #include <RiscvEmulatorTypeHook.h>
 
+#include "hook.h"
+#include "trace.h"
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-parameter"
 #pragma GCC diagnostic ignored "-Wunused-variable"
 
-void printInteger(
-    const char *name,
-    const uint32_t value,
-    const uint8_t length,
-    const uint8_t issigned) {
+/**
+ * Prints one hook event. Returns 0 when the event is not handled and the fallback print must be used.
+ */
+typedef uint8_t (*HookFormatter_t)(FILE *out, const HookEvent_t *event);
+
+typedef struct {
+    const char *name;
+    HookFormatter_t formatter;
+} HookFormat_t;
 
-    printf(", %s: ", name);
+static const char *tab = "                                         ";
 
-    switch (length) {
+static inline const char *instructionName(const HookEvent_t *event);
+static inline const char *immediateName(const HookEvent_t *event);
+
+static void printImmediate(FILE *out, const HookEvent_t *event) {
+    fprintf(out, ", %s: ", immediateName(event));
+
+    switch (event->immlength) {
         case 1: {
-            printf("0x%02X", (uint8_t)value);
+            fprintf(out, "0x%02X", (uint8_t)event->imm);
             break;
         }
         case 2: {
-            printf("0x%04X", (uint16_t)value);
+            fprintf(out, "0x%04X", (uint16_t)event->imm);
             break;
         }
         default: {
-            printf("0x%08X", value);
+            fprintf(out, "0x%08X", event->imm);
             break;
         }
     }
 
-    if (issigned) {
-        printf("(%d)", (int32_t)value);
+    if (event->immissigned) {
+        fprintf(out, "(%d)", (int32_t)event->imm);
     } else {
-        printf("(%d)", value);
+        fprintf(out, "(%d)", event->imm);
     }
 }
 
+static void printRegisterAssignment(FILE *out, const uint8_t num, const uint32_t value) {
+    fprintf(out, "%sx%u(%s) = 0x%08X\n",
+            tab,
+            num,
+            RiscvEmulatorGetRegisterSymbolicName(num),
+            value);
+}
+
+static void printProgramCounterAssignment(FILE *out, const HookEvent_t *event) {
+    fprintf(out, "%spc = 0x%08X\n",
+            tab,
+            event->programcounternext);
+}
+
+static void printRd(FILE *out, const HookEvent_t *event) {
+    fprintf(out, ", rd x%u(%s): 0x%08X",
+            event->rdnum,
+            RiscvEmulatorGetRegisterSymbolicName(event->rdnum),
+            event->rd);
+}
+
+static void printRs1(FILE *out, const HookEvent_t *event) {
+    fprintf(out, ", rs1 x%u(%s): 0x%08X",
+            event->rs1num,
+            RiscvEmulatorGetRegisterSymbolicName(event->rs1num),
+            event->rs1);
+}
+
+static void printRs2(FILE *out, const HookEvent_t *event) {
+    fprintf(out, ", rs2 x%u(%s): 0x%08X",
+            event->rs2num,
+            RiscvEmulatorGetRegisterSymbolicName(event->rs2num),
+            event->rs2);
+}
+
 /**
- * Debug prints.
+ * R-type, Integer Register-Register instructions.
+ *
+ * prints rd, rs1 and rs2.
  */
-void RiscvEmulatorHook(
-    const RiscvEmulatorState_t *state,
-    const RiscvEmulatorHookContext_t *context) {
+static uint8_t formatRegisterRegister(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRd(out, event);
+        printRs1(out, event);
+        printRs2(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        if (event->rdnum != 0) {
+            printRegisterAssignment(out, event->rdnum, event->rd);
+        }
+        return 1;
+    }
 
-    const void *rd = context->rd;
-    const uint8_t rdnum = context->rdnum;
-    const char *rdname = RiscvEmulatorGetRegisterSymbolicName(rdnum);
-    const void *rs1 = context->rs1;
-    const uint8_t rs1num = context->rs1num;
-    const char *rs1name = RiscvEmulatorGetRegisterSymbolicName(rs1num);
-    const void *rs2 = context->rs2;
-    const uint8_t rs2num = context->rs2num;
-    const char *rs2name = RiscvEmulatorGetRegisterSymbolicName(rs2num);
+    return 0;
+}
 
-#if (RVE_E_ZICSR == 1)
-    const uint16_t csrnum = context->csrnum;
-    const void *csr = context->csr;
-    const char *csrname = RiscvEmulatorGetCSRName(csrnum);
-#endif
+/**
+ * R-type pseudoinstructions neg, snez, sltz and sgtz.
+ */
+static uint8_t formatRegisterRegisterPseudo(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        const char *pseudo = NULL;
+        uint8_t showrs1 = 0;
+
+        if (event->instructionid == HOOKINSTRUCTION_SUB &&
+            event->rs1num == 0) {
+            pseudo = "neg";
+        } else if (event->instructionid == HOOKINSTRUCTION_SLTU &&
+                   event->rs1num == 0) {
+            pseudo = "snez";
+        } else if (event->instructionid == HOOKINSTRUCTION_SLT &&
+                   event->rs2num == 0) {
+            pseudo = "sltz";
+            showrs1 = 1;
+        } else if (event->instructionid == HOOKINSTRUCTION_SLT &&
+                   event->rs1num == 0) {
+            pseudo = "sgtz";
+        }
 
-    const uint32_t imm = context->imm;
-    const uint8_t immissigned = context->immissigned;
-    char *immname = "imm";
-    if (context->immname != NULL) {
-        immname = context->immname;
-    }
-    uint8_t immlength = 4;
-    if (context->immlength != 0) {
-        immlength = context->immlength;
+        if (pseudo != NULL) {
+            fprintf(out, ", %s", pseudo);
+            printRd(out, event);
+            if (showrs1) {
+                printRs1(out, event);
+            } else {
+                printRs2(out, event);
+            }
+            fprintf(out, "\n");
+            return 1;
+        }
     }
 
-    const uint32_t memorylocation = context->memorylocation;
-    const uint8_t length = context->length;
+    return formatRegisterRegister(out, event);
+}
 
-    const void *ra = &state->reg.ra;
-    const void *sp = &state->reg.sp;
+/**
+ * I-type, Integer Register-Immediate instructions.
+ *
+ * prints rd, rs1 and imm.
+ */
+static uint8_t formatRegisterImmediate(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRd(out, event);
+        printRs1(out, event);
+        printImmediate(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        if (event->rdnum != 0) {
+            printRegisterAssignment(out, event->rdnum, event->rd);
+        }
+        return 1;
+    }
 
-    const char *tab = "                                         ";
+    return 0;
+}
 
-    if (context->hook == HOOK_UNKNOWN ||
-        context->hook == HOOK_BEGIN) {
-        printf("pc: 0x%08X", state->programcounter);
+/**
+ * I-type pseudoinstructions nop, mv, not and seqz.
+ */
+static uint8_t formatRegisterImmediatePseudo(FILE *out, const HookEvent_t *event) {
+    // Detect nop
+    if (event->instructionid == HOOKINSTRUCTION_ADDI &&
+        event->rdnum == 0) {
+        if (event->hook == HOOK_BEGIN) {
+            fprintf(out, ", nop\n");
+            return 1;
+        } else if (event->hook == HOOK_END) {
+            return 1;
+        }
+    }
 
-#if (RVE_E_C == 1)
-        if (state->instruction.copcode.op != OPCODE16_QUADRANT_INVALID) {
-            printf(", instruction:     0x%04X", (uint16_t)state->instruction.value);
-        } else
-#endif
-        {
-            printf(", instruction: 0x%08X", state->instruction.value);
+    if (event->hook == HOOK_BEGIN) {
+        const char *pseudo = NULL;
+
+        if (event->instructionid == HOOKINSTRUCTION_ADDI &&
+            event->imm == 0) {
+            pseudo = "mv";
+        } else if (event->instructionid == HOOKINSTRUCTION_XORI &&
+                   (int16_t)event->imm == -1) {
+            pseudo = "not";
+        } else if (event->instructionid == HOOKINSTRUCTION_SLTIU &&
+                   event->imm == 1) {
+            pseudo = "seqz";
         }
 
-        if (context->instruction == NULL ||
-            context->instruction[0] == '\0') {
-            printf(", ??? instruction string not set");
-            return;
+        if (pseudo != NULL) {
+            fprintf(out, ", %s", pseudo);
+            printRd(out, event);
+            printRs1(out, event);
+            fprintf(out, "\n");
+            return 1;
         }
     }
 
-    /**
-     * R-type pseudoinstructions.
-     */
+    return formatRegisterImmediate(out, event);
+}
 
-    // Detect neg
-    if (strcmp(context->instruction, "sub") == 0 &&
-        rs1num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", neg, rd x%u(%s): 0x%08X, rs2 x%u(%s): 0x%08X\n",
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            return;
+/**
+ * jalr and the pseudoinstructions ret and jr.
+ */
+static uint8_t formatJalr(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        if (event->rdnum == 0 &&
+            event->rs1num == 1 &&
+            event->imm == 0) {
+            fprintf(out, ", ret");
+            printRs1(out, event);
+            fprintf(out, "\n");
+            return 1;
+        }
+
+        if (event->rdnum == 0) {
+            fprintf(out, ", jr");
+            printRs1(out, event);
+            printImmediate(out, event);
+            fprintf(out, "\n");
+            return 1;
         }
+
+        fprintf(out, ", %s", instructionName(event));
+        printRd(out, event);
+        printRs1(out, event);
+        printImmediate(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        if (event->rdnum != 0) {
+            printRegisterAssignment(out, event->rdnum, event->rd);
+            printProgramCounterAssignment(out, event);
+        }
+        return 1;
     }
 
-    // Detect snez
-    if (strcmp(context->instruction, "sltu") == 0 &&
-        rs1num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", snez, rd x%u(%s): 0x%08X, rs2 x%u(%s): 0x%08X\n",
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            return;
+    return 0;
+}
+
+/**
+ * I-type Load instructions.
+ *
+ * prints rd, rs1, imm and memory location.
+ */
+static uint8_t formatLoad(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRd(out, event);
+        printRs1(out, event);
+        printImmediate(out, event);
+        fprintf(out, ", memorylocation: 0x%08X\n",
+                event->memorylocation);
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        const char *rdname = RiscvEmulatorGetRegisterSymbolicName(event->rdnum);
+
+        switch (event->instructionid) {
+            case HOOKINSTRUCTION_LB: {
+                fprintf(out, "%sx%u(%s) = %i\n", tab, event->rdnum, rdname, (int8_t)event->rd);
+                break;
+            }
+            case HOOKINSTRUCTION_LBU: {
+                fprintf(out, "%sx%u(%s) = %u\n", tab, event->rdnum, rdname, (uint8_t)event->rd);
+                break;
+            }
+            case HOOKINSTRUCTION_LH: {
+                fprintf(out, "%sx%u(%s) = %i\n", tab, event->rdnum, rdname, (int16_t)event->rd);
+                break;
+            }
+            case HOOKINSTRUCTION_LHU: {
+                fprintf(out, "%sx%u(%s) = %u\n", tab, event->rdnum, rdname, (uint16_t)event->rd);
+                break;
+            }
+            default: {
+                break;
+            }
         }
+
+        printRegisterAssignment(out, event->rdnum, event->rd);
+        return 1;
     }
 
-    // Detect sltz
-    if (strcmp(context->instruction, "slt") == 0 &&
-        rs2num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", sltz, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X\n",
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            return;
+    return 0;
+}
+
+/**
+ * I-type Misc-Mem instructions and the I-type System instructions ecall and ebreak.
+ */
+static uint8_t formatName(FILE *out, const HookEvent_t *event) {
+    fprintf(out, ", %s\n", instructionName(event));
+    return 1;
+}
+
+static uint8_t formatMret(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s\n", instructionName(event));
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        printProgramCounterAssignment(out, event);
+        return 1;
+    }
+
+    return 0;
+}
+
+#if (RVE_E_ZICSR == 1)
+static uint8_t formatCsr(FILE *out, const HookEvent_t *event) {
+    const char *csrname = RiscvEmulatorGetCSRName(event->csrnum);
+
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRd(out, event);
+        if (event->instructionid == HOOKINSTRUCTION_CSRRWI ||
+            event->instructionid == HOOKINSTRUCTION_CSRRSI ||
+            event->instructionid == HOOKINSTRUCTION_CSRRCI) {
+            printImmediate(out, event);
+        } else {
+            printRs1(out, event);
         }
+        fprintf(out, ", csr 0x%04X(%s): 0x%08X\n",
+                event->csrnum,
+                csrname,
+                event->csr);
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        fprintf(out, "%s%s = 0x%08X\n",
+                tab,
+                csrname,
+                event->csr);
+        if (event->rdnum != 0) {
+            printRegisterAssignment(out, event->rdnum, event->rd);
+        }
+        return 1;
     }
 
-    // Detect sgtz
-    if (strcmp(context->instruction, "slt") == 0 &&
-        rs1num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", sgtz, rd x%u(%s): 0x%08X, rs2 x%u(%s): 0x%08X\n",
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            return;
+    return 0;
+}
+#endif
+
+/**
+ * S-type, Compressed Store instructions.
+ *
+ * prints rs1, rs2, imm and memory location.
+ */
+static uint8_t formatStore(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRs1(out, event);
+        printRs2(out, event);
+        printImmediate(out, event);
+        fprintf(out, ", memorylocation: 0x%08X\n",
+                event->memorylocation);
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        if (event->length == 1) {
+            fprintf(out, "%s0x%08X = 0x%02X\n",
+                    tab,
+                    event->memorylocation,
+                    (uint8_t)event->rs2);
+        } else if (event->length == 2) {
+            fprintf(out, "%s0x%08X = 0x%04X\n",
+                    tab,
+                    event->memorylocation,
+                    (uint16_t)event->rs2);
+        } else {
+            fprintf(out, "%s0x%08X = 0x%08X\n",
+                    tab,
+                    event->memorylocation,
+                    event->rs2);
         }
+        return 1;
     }
 
-    /**
-     * R-type, Integer Register-Register instructions.
-     *
-     * prints rd, rs1 and rs2.
-     */
+    return 0;
+}
 
-    if (strcmp(context->instruction, "add") == 0 ||
-        strcmp(context->instruction, "sub") == 0 ||
-        strcmp(context->instruction, "sll") == 0 ||
-        strcmp(context->instruction, "slt") == 0 ||
-        strcmp(context->instruction, "sltu") == 0 ||
-        strcmp(context->instruction, "xor") == 0 ||
-        strcmp(context->instruction, "srl") == 0 ||
-        strcmp(context->instruction, "sra") == 0 ||
-        strcmp(context->instruction, "or") == 0 ||
-        strcmp(context->instruction, "and") == 0 ||
-        strcmp(context->instruction, "shadd") == 0 ||
-        strcmp(context->instruction, "andn") == 0 ||
-        strcmp(context->instruction, "orn") == 0 ||
-        strcmp(context->instruction, "xnor") == 0 ||
-        strcmp(context->instruction, "max") == 0 ||
-        strcmp(context->instruction, "maxu") == 0 ||
-        strcmp(context->instruction, "min") == 0 ||
-        strcmp(context->instruction, "minu") == 0 ||
-        strcmp(context->instruction, "rol") == 0 ||
-        strcmp(context->instruction, "ror") == 0 ||
-        strcmp(context->instruction, "clmul") == 0 ||
-        strcmp(context->instruction, "clmulh") == 0 ||
-        strcmp(context->instruction, "clmulr") == 0 ||
-        strcmp(context->instruction, "bclr") == 0 ||
-        strcmp(context->instruction, "bext") == 0 ||
-        strcmp(context->instruction, "binv") == 0 ||
-        strcmp(context->instruction, "bset") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X, rs2 x%u(%s): 0x%08X\n",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1,
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            return;
-        } else if (context->hook == HOOK_END) {
-            if (rdnum != 0) {
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
+/**
+ * B-type instructions and the pseudoinstructions beqz, bnez, bgez, bltz, blez and bgtz.
+ *
+ * prints rs1, rs2, and imm.
+ */
+static uint8_t formatBranch(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        const char *pseudo = NULL;
+        uint8_t showrs1 = 1;
+
+        if (event->rs2num == 0) {
+            switch (event->instructionid) {
+                case HOOKINSTRUCTION_BEQ: {
+                    pseudo = "beqz";
+                    break;
+                }
+                case HOOKINSTRUCTION_BNE: {
+                    pseudo = "bnez";
+                    break;
+                }
+                case HOOKINSTRUCTION_BGE: {
+                    pseudo = "bgez";
+                    break;
+                }
+                case HOOKINSTRUCTION_BLT: {
+                    pseudo = "bltz";
+                    break;
+                }
+                default: {
+                    break;
+                }
             }
-            return;
         }
-    }
 
-    /**
-     * I-type and Compressed Immediate pseudoinstructions.
-     */
+        if (pseudo == NULL &&
+            event->rs1num == 0) {
+            showrs1 = 0;
+            if (event->instructionid == HOOKINSTRUCTION_BGE) {
+                pseudo = "blez";
+            } else if (event->instructionid == HOOKINSTRUCTION_BLT) {
+                pseudo = "bgtz";
+            }
+        }
 
-    // Detect nop
-    if (strcmp(context->instruction, "addi") == 0 &&
-        rdnum == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", nop\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            return;
+        if (pseudo != NULL) {
+            fprintf(out, ", %s", pseudo);
+            if (showrs1) {
+                printRs1(out, event);
+            } else {
+                printRs2(out, event);
+            }
+            printImmediate(out, event);
+            fprintf(out, "\n");
+            return 1;
         }
+
+        fprintf(out, ", %s", instructionName(event));
+        printRs1(out, event);
+        printRs2(out, event);
+        printImmediate(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        printProgramCounterAssignment(out, event);
+        return 1;
     }
 
-    // Detect mv
-    if (strcmp(context->instruction, "addi") == 0 &&
-        imm == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", mv, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X\n",
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            return;
+    return 0;
+}
+
+/**
+ * U-type instructions.
+ *
+ * prints rd and imm.
+ */
+static uint8_t formatUpperImmediate(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRd(out, event);
+        printImmediate(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        if (event->rdnum != 0) {
+            printRegisterAssignment(out, event->rdnum, event->rd);
         }
+        return 1;
     }
 
-    // Detect not
-    if (strcmp(context->instruction, "xori") == 0 &&
-        (int16_t)imm == -1) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", not, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X\n",
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            return;
+    return 0;
+}
+
+/**
+ * J-type instructions and the pseudoinstruction j.
+ *
+ * prints rd and imm.
+ */
+static uint8_t formatJal(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        if (event->rdnum == 0) {
+            fprintf(out, ", j");
+        } else {
+            fprintf(out, ", %s", instructionName(event));
+            printRd(out, event);
+        }
+        printImmediate(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        if (event->rdnum != 0) {
+            printRegisterAssignment(out, event->rdnum, event->rd);
+            printProgramCounterAssignment(out, event);
         }
+        return 1;
     }
 
-    // Detect seqz
-    if (strcmp(context->instruction, "sltiu") == 0 &&
-        imm == 1) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", seqz, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X\n",
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            return;
+    return 0;
+}
+
+/**
+ * Compressed Register instructions.
+ * Compressed Arithmetic instructions.
+ */
+static uint8_t formatCompressedRegister(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        if (event->instructionid == HOOKINSTRUCTION_C_MV) {
+            fprintf(out, ", %s, rd", instructionName(event));
+        } else {
+            fprintf(out, ", %s, rs1/rd", instructionName(event));
         }
+        fprintf(out, " x%u(%s): 0x%08X",
+                event->rdnum,
+                RiscvEmulatorGetRegisterSymbolicName(event->rdnum),
+                event->rd);
+        printRs2(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        printRegisterAssignment(out, event->rdnum, event->rd);
+        return 1;
     }
 
-    // Detect c.nop
-    if (strcmp(context->instruction, "c.addi") == 0 &&
-        rdnum == 0 &&
-        rs1num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", c.nop\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            return;
-        }
+    return 0;
+}
+
+static uint8_t formatCompressedJr(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRs1(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        printProgramCounterAssignment(out, event);
+        return 1;
     }
 
-    // Detect ret
-    if (strcmp(context->instruction, "jalr") == 0 &&
-        rdnum == 0 && rs1num == 1 && imm == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", ret, rs1 x%u(%s): 0x%08X\n",
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            return;
+    return 0;
+}
+
+/**
+ * Compressed Jump instructions.
+ */
+static uint8_t formatCompressedJumpAndLink(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s, x1(ra): 0x%08X",
+                instructionName(event),
+                event->ra);
+        if (event->instructionid == HOOKINSTRUCTION_C_JALR) {
+            printRs1(out, event);
+        } else {
+            printImmediate(out, event);
         }
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        fprintf(out, "%sx1(ra) = 0x%08X\n",
+                tab,
+                event->ra);
+        printProgramCounterAssignment(out, event);
+        return 1;
     }
 
-    // Detect jr
-    if (strcmp(context->instruction, "jalr") == 0 &&
-        rdnum == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", jr, rs1 x%u(%s): 0x%08X",
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        }
+    return 0;
+}
+
+static uint8_t formatCompressedJ(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printImmediate(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        printProgramCounterAssignment(out, event);
+        return 1;
     }
 
-    /**
-     * I-type, Integer Register-Immediate instructions.
-     *
-     * prints rd, rs1 and imm.
-     */
+    return 0;
+}
 
-    if (strcmp(context->instruction, "jalr") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            if (rdnum != 0) {
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-                printf("%spc = 0x%08X\n",
-                       tab,
-                       state->programcounternext);
-            }
-            return;
+/**
+ * Compressed Immediate instructions and the pseudoinstruction c.nop.
+ */
+static uint8_t formatCompressedImmediate(FILE *out, const HookEvent_t *event) {
+    // Detect c.nop
+    if (event->instructionid == HOOKINSTRUCTION_C_ADDI &&
+        event->rdnum == 0 &&
+        event->rs1num == 0) {
+        if (event->hook == HOOK_BEGIN) {
+            fprintf(out, ", c.nop\n");
+            return 1;
+        } else if (event->hook == HOOK_END) {
+            return 1;
         }
     }
 
-    if (strcmp(context->instruction, "addi") == 0 ||
-        strcmp(context->instruction, "slli") == 0 ||
-        strcmp(context->instruction, "slti") == 0 ||
-        strcmp(context->instruction, "sltiu") == 0 ||
-        strcmp(context->instruction, "xori") == 0 ||
-        strcmp(context->instruction, "srli") == 0 ||
-        strcmp(context->instruction, "srai") == 0 ||
-        strcmp(context->instruction, "ori") == 0 ||
-        strcmp(context->instruction, "andi") == 0 ||
-        strcmp(context->instruction, "rori") == 0 ||
-        strcmp(context->instruction, "bclri") == 0 ||
-        strcmp(context->instruction, "bexti") == 0 ||
-        strcmp(context->instruction, "binvi") == 0 ||
-        strcmp(context->instruction, "bseti") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            if (rdnum != 0) {
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            }
-            return;
-        }
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRd(out, event);
+        printImmediate(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        printRegisterAssignment(out, event->rdnum, event->rd);
+        return 1;
     }
 
-    /**
-     * I-type Load instructions.
-     *
-     * prints rd, rs1, imm and memory location.
-     */
+    return 0;
+}
 
-    if (strcmp(context->instruction, "lb") == 0 ||
-        strcmp(context->instruction, "lbu") == 0 ||
-        strcmp(context->instruction, "lh") == 0 ||
-        strcmp(context->instruction, "lhu") == 0 ||
-        strcmp(context->instruction, "lw") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf(", memorylocation: 0x%08X\n",
-                   memorylocation);
-            return;
-        } else if (context->hook == HOOK_END) {
-            if (strcmp(context->instruction, "lb") == 0) {
-                printf("%sx%u(%s) = %i\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(int8_t *)rd);
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            } else if (strcmp(context->instruction, "lbu") == 0) {
-                printf("%sx%u(%s) = %u\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint8_t *)rd);
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            } else if (strcmp(context->instruction, "lh") == 0) {
-                printf("%sx%u(%s) = %i\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(int16_t *)rd);
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            } else if (strcmp(context->instruction, "lhu") == 0) {
-                printf("%sx%u(%s) = %u\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint16_t *)rd);
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            } else {
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            }
-            return;
+/**
+ * Compressed Wide Immediate instructions.
+ */
+static uint8_t formatCompressedAddi4spn(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRd(out, event);
+        fprintf(out, ", sp: 0x%08X", event->sp);
+        printImmediate(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        if (event->rdnum != 0) {
+            printRegisterAssignment(out, event->rdnum, event->rd);
         }
+        return 1;
     }
 
-    /**
-     * I-type Misc-Mem instructions.
-     */
+    return 0;
+}
 
-    if (strcmp(context->instruction, "fence") == 0 ||
-        strcmp(context->instruction, "fencei") == 0) {
-        printf(", %s\n", context->instruction);
-        return;
+/**
+ * Compressed Stack-relative Store instructions.
+ */
+static uint8_t formatCompressedSwsp(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRs2(out, event);
+        fprintf(out, ", sp: 0x%08X", event->sp);
+        printImmediate(out, event);
+        fprintf(out, ", memorylocation: 0x%08X\n",
+                event->memorylocation);
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        fprintf(out, "%s0x%08X = 0x%08X\n",
+                tab,
+                event->memorylocation,
+                event->rs2);
+        return 1;
     }
 
-    /**
-     * I-type System instructions.
-     */
+    return 0;
+}
 
-    if (strcmp(context->instruction, "mret") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s\n", context->instruction);
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%spc = 0x%08X\n",
-                   tab,
-                   state->programcounternext);
-            return;
+/**
+ * Compressed Load instructions.
+ */
+static uint8_t formatCompressedLoad(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRd(out, event);
+        if (event->instructionid == HOOKINSTRUCTION_C_LWSP) {
+            fprintf(out, ", sp: 0x%08X", event->sp);
+        } else {
+            printRs1(out, event);
         }
+        printImmediate(out, event);
+        fprintf(out, ", memorylocation: 0x%08X\n",
+                event->memorylocation);
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        printRegisterAssignment(out, event->rdnum, event->rd);
+        return 1;
     }
 
-    if (strcmp(context->instruction, "ecall") == 0 ||
-        strcmp(context->instruction, "ebreak") == 0) {
-        printf(", %s\n", context->instruction);
-        return;
+    return 0;
+}
+
+/**
+ * Compressed Branch instructions.
+ */
+static uint8_t formatCompressedBranch(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_BEGIN) {
+        fprintf(out, ", %s", instructionName(event));
+        printRs1(out, event);
+        printImmediate(out, event);
+        fprintf(out, "\n");
+        return 1;
+    } else if (event->hook == HOOK_END) {
+        printProgramCounterAssignment(out, event);
+        return 1;
     }
 
+    return 0;
+}
+
 #if (RVE_E_ZICSR == 1)
-    if (strcmp(context->instruction, "csrrw") == 0 ||
-        strcmp(context->instruction, "csrrs") == 0 ||
-        strcmp(context->instruction, "csrrc") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X, csr 0x%04X(%s): 0x%08X\n",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1,
-                   csrnum,
-                   csrname,
-                   *(uint32_t *)csr);
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%s%s = 0x%08X\n",
-                   tab,
-                   csrname,
-                   *(uint32_t *)csr);
-            if (rdnum != 0) {
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            }
-            return;
+/**
+ * Not instructions. Like trap.
+ */
+static uint8_t formatTrap(FILE *out, const HookEvent_t *event) {
+    const char *causedescription = RiscvEmulatorGetMcauseException(
+        event->mcauseinterrupt,
+        event->mcauseexceptioncode);
+
+    fprintf(out, ", trap, interrupt: %d, exception code %d: %s\n",
+            event->mcauseinterrupt,
+            event->mcauseexceptioncode,
+            causedescription);
+    fprintf(out, "%smtval = 0x%08X\n",
+            tab,
+            event->mtval);
+    fprintf(out, "%smstatus.mpp = %d\n",
+            tab,
+            event->mstatusmpp);
+    fprintf(out, "%smstatus.mpie = %d\n",
+            tab,
+            event->mstatusmpie);
+    fprintf(out, "%smstatus.mie = %d\n",
+            tab,
+            event->mstatusmie);
+    fprintf(out, "%smepc = 0x%08X\n",
+            tab,
+            event->mepc);
+    printProgramCounterAssignment(out, event);
+    return 1;
+}
+#endif
+
+/**
+ * Instruction string and formatter per instruction identifier.
+ */
+static const HookFormat_t hookformat[HOOKINSTRUCTION_COUNT] = {
+    [HOOKINSTRUCTION_UNSET] = {"", NULL},
+    [HOOKINSTRUCTION_UNKNOWN] = {"unknown", NULL},
+
+    [HOOKINSTRUCTION_ADD] = {"add", formatRegisterRegister},
+    [HOOKINSTRUCTION_SUB] = {"sub", formatRegisterRegisterPseudo},
+    [HOOKINSTRUCTION_SLL] = {"sll", formatRegisterRegister},
+    [HOOKINSTRUCTION_SLT] = {"slt", formatRegisterRegisterPseudo},
+    [HOOKINSTRUCTION_SLTU] = {"sltu", formatRegisterRegisterPseudo},
+    [HOOKINSTRUCTION_XOR] = {"xor", formatRegisterRegister},
+    [HOOKINSTRUCTION_SRL] = {"srl", formatRegisterRegister},
+    [HOOKINSTRUCTION_SRA] = {"sra", formatRegisterRegister},
+    [HOOKINSTRUCTION_OR] = {"or", formatRegisterRegister},
+    [HOOKINSTRUCTION_AND] = {"and", formatRegisterRegister},
+    [HOOKINSTRUCTION_SHADD] = {"shadd", formatRegisterRegister},
+    [HOOKINSTRUCTION_ANDN] = {"andn", formatRegisterRegister},
+    [HOOKINSTRUCTION_ORN] = {"orn", formatRegisterRegister},
+    [HOOKINSTRUCTION_XNOR] = {"xnor", formatRegisterRegister},
+    [HOOKINSTRUCTION_MAX] = {"max", formatRegisterRegister},
+    [HOOKINSTRUCTION_MAXU] = {"maxu", formatRegisterRegister},
+    [HOOKINSTRUCTION_MIN] = {"min", formatRegisterRegister},
+    [HOOKINSTRUCTION_MINU] = {"minu", formatRegisterRegister},
+    [HOOKINSTRUCTION_ROL] = {"rol", formatRegisterRegister},
+    [HOOKINSTRUCTION_ROR] = {"ror", formatRegisterRegister},
+    [HOOKINSTRUCTION_CLMUL] = {"clmul", formatRegisterRegister},
+    [HOOKINSTRUCTION_CLMULH] = {"clmulh", formatRegisterRegister},
+    [HOOKINSTRUCTION_CLMULR] = {"clmulr", formatRegisterRegister},
+    [HOOKINSTRUCTION_BCLR] = {"bclr", formatRegisterRegister},
+    [HOOKINSTRUCTION_BEXT] = {"bext", formatRegisterRegister},
+    [HOOKINSTRUCTION_BINV] = {"binv", formatRegisterRegister},
+    [HOOKINSTRUCTION_BSET] = {"bset", formatRegisterRegister},
+
+    [HOOKINSTRUCTION_ADDI] = {"addi", formatRegisterImmediatePseudo},
+    [HOOKINSTRUCTION_SLLI] = {"slli", formatRegisterImmediate},
+    [HOOKINSTRUCTION_SLTI] = {"slti", formatRegisterImmediate},
+    [HOOKINSTRUCTION_SLTIU] = {"sltiu", formatRegisterImmediatePseudo},
+    [HOOKINSTRUCTION_XORI] = {"xori", formatRegisterImmediatePseudo},
+    [HOOKINSTRUCTION_SRLI] = {"srli", formatRegisterImmediate},
+    [HOOKINSTRUCTION_SRAI] = {"srai", formatRegisterImmediate},
+    [HOOKINSTRUCTION_ORI] = {"ori", formatRegisterImmediate},
+    [HOOKINSTRUCTION_ANDI] = {"andi", formatRegisterImmediate},
+    [HOOKINSTRUCTION_RORI] = {"rori", formatRegisterImmediate},
+    [HOOKINSTRUCTION_BCLRI] = {"bclri", formatRegisterImmediate},
+    [HOOKINSTRUCTION_BEXTI] = {"bexti", formatRegisterImmediate},
+    [HOOKINSTRUCTION_BINVI] = {"binvi", formatRegisterImmediate},
+    [HOOKINSTRUCTION_BSETI] = {"bseti", formatRegisterImmediate},
+    [HOOKINSTRUCTION_JALR] = {"jalr", formatJalr},
+
+    [HOOKINSTRUCTION_LB] = {"lb", formatLoad},
+    [HOOKINSTRUCTION_LBU] = {"lbu", formatLoad},
+    [HOOKINSTRUCTION_LH] = {"lh", formatLoad},
+    [HOOKINSTRUCTION_LHU] = {"lhu", formatLoad},
+    [HOOKINSTRUCTION_LW] = {"lw", formatLoad},
+
+    [HOOKINSTRUCTION_FENCE] = {"fence", formatName},
+    [HOOKINSTRUCTION_FENCEI] = {"fencei", formatName},
+    [HOOKINSTRUCTION_MRET] = {"mret", formatMret},
+    [HOOKINSTRUCTION_ECALL] = {"ecall", formatName},
+    [HOOKINSTRUCTION_EBREAK] = {"ebreak", formatName},
+
+#if (RVE_E_ZICSR == 1)
+    [HOOKINSTRUCTION_CSRRW] = {"csrrw", formatCsr},
+    [HOOKINSTRUCTION_CSRRS] = {"csrrs", formatCsr},
+    [HOOKINSTRUCTION_CSRRC] = {"csrrc", formatCsr},
+    [HOOKINSTRUCTION_CSRRWI] = {"csrrwi", formatCsr},
+    [HOOKINSTRUCTION_CSRRSI] = {"csrrsi", formatCsr},
+    [HOOKINSTRUCTION_CSRRCI] = {"csrrci", formatCsr},
+#else
+    [HOOKINSTRUCTION_CSRRW] = {"csrrw", NULL},
+    [HOOKINSTRUCTION_CSRRS] = {"csrrs", NULL},
+    [HOOKINSTRUCTION_CSRRC] = {"csrrc", NULL},
+    [HOOKINSTRUCTION_CSRRWI] = {"csrrwi", NULL},
+    [HOOKINSTRUCTION_CSRRSI] = {"csrrsi", NULL},
+    [HOOKINSTRUCTION_CSRRCI] = {"csrrci", NULL},
+#endif
+
+    [HOOKINSTRUCTION_SB] = {"sb", formatStore},
+    [HOOKINSTRUCTION_SH] = {"sh", formatStore},
+    [HOOKINSTRUCTION_SW] = {"sw", formatStore},
+
+    [HOOKINSTRUCTION_BEQ] = {"beq", formatBranch},
+    [HOOKINSTRUCTION_BNE] = {"bne", formatBranch},
+    [HOOKINSTRUCTION_BGE] = {"bge", formatBranch},
+    [HOOKINSTRUCTION_BGEU] = {"bgeu", formatBranch},
+    [HOOKINSTRUCTION_BLT] = {"blt", formatBranch},
+    [HOOKINSTRUCTION_BLTU] = {"bltu", formatBranch},
+
+    [HOOKINSTRUCTION_LUI] = {"lui", formatUpperImmediate},
+    [HOOKINSTRUCTION_AUIPC] = {"auipc", formatUpperImmediate},
+    [HOOKINSTRUCTION_JAL] = {"jal", formatJal},
+
+    [HOOKINSTRUCTION_C_ADD] = {"c.add", formatCompressedRegister},
+    [HOOKINSTRUCTION_C_SUB] = {"c.sub", formatCompressedRegister},
+    [HOOKINSTRUCTION_C_XOR] = {"c.xor", formatCompressedRegister},
+    [HOOKINSTRUCTION_C_OR] = {"c.or", formatCompressedRegister},
+    [HOOKINSTRUCTION_C_AND] = {"c.and", formatCompressedRegister},
+    [HOOKINSTRUCTION_C_MV] = {"c.mv", formatCompressedRegister},
+    [HOOKINSTRUCTION_C_JR] = {"c.jr", formatCompressedJr},
+    [HOOKINSTRUCTION_C_JALR] = {"c.jalr", formatCompressedJumpAndLink},
+    [HOOKINSTRUCTION_C_LI] = {"c.li", formatCompressedImmediate},
+    [HOOKINSTRUCTION_C_LUI] = {"c.lui", formatCompressedImmediate},
+    [HOOKINSTRUCTION_C_ADDI] = {"c.addi", formatCompressedImmediate},
+    [HOOKINSTRUCTION_C_ADDI16SP] = {"c.addi16sp", formatCompressedImmediate},
+    [HOOKINSTRUCTION_C_SLLI] = {"c.slli", formatCompressedImmediate},
+    [HOOKINSTRUCTION_C_SWSP] = {"c.swsp", formatCompressedSwsp},
+    [HOOKINSTRUCTION_C_SW] = {"c.sw", formatStore},
+    [HOOKINSTRUCTION_C_ADDI4SPN] = {"c.addi4spn", formatCompressedAddi4spn},
+    [HOOKINSTRUCTION_C_LWSP] = {"c.lwsp", formatCompressedLoad},
+    [HOOKINSTRUCTION_C_LW] = {"c.lw", formatCompressedLoad},
+    [HOOKINSTRUCTION_C_SRLI] = {"c.srli", formatCompressedImmediate},
+    [HOOKINSTRUCTION_C_SRAI] = {"c.srai", formatCompressedImmediate},
+    [HOOKINSTRUCTION_C_ANDI] = {"c.andi", formatCompressedImmediate},
+    [HOOKINSTRUCTION_C_BEQZ] = {"c.beqz", formatCompressedBranch},
+    [HOOKINSTRUCTION_C_BNEZ] = {"c.bnez", formatCompressedBranch},
+    [HOOKINSTRUCTION_C_JAL] = {"c.jal", formatCompressedJumpAndLink},
+    [HOOKINSTRUCTION_C_J] = {"c.j", formatCompressedJ},
+
+#if (RVE_E_ZICSR == 1)
+    [HOOKINSTRUCTION_TRAP] = {"_trap", formatTrap},
+#else
+    [HOOKINSTRUCTION_TRAP] = {"_trap", NULL},
+#endif
+};
+
+/**
+ * Hook state is per thread, every thread of the batch runner emulates its own instance.
+ */
+static _Thread_local HookOutput_t hookoutput = HOOKOUTPUT_TEXT;
+static _Thread_local FILE *hooklog;
+static _Thread_local SymbolTable_t *hooksymbols;
+static _Thread_local void (*hooklistener)(const HookEvent_t *event, void *argument);
+static _Thread_local void *hooklistenerargument;
+
+/**
+ * Flight recorder, the last hookringsize events.
+ */
+static _Thread_local HookEvent_t *hookring;
+static _Thread_local size_t hookringsize;
+static _Thread_local size_t hookringnext;
+static _Thread_local size_t hookringcount;
+
+/**
+ * Executions per instruction identifier, see HookSetProfile.
+ */
+static _Thread_local uint64_t *hookprofile;
+
+/**
+ * Names of the instruction identifiers handed out at runtime.
+ */
+static _Thread_local const char *hookinstructionname[HOOKINSTRUCTION_CAPACITY - HOOKINSTRUCTION_COUNT];
+static _Thread_local uint16_t hookinstructioncount = HOOKINSTRUCTION_COUNT;
+
+/**
+ * Names of the immediate identifiers.
+ */
+static _Thread_local const char *hookimmname[HOOKIMMNAME_CAPACITY] = {"imm"};
+static _Thread_local uint8_t hookimmnamecount = 1;
+
+/**
+ * Identifiers of which the name has been written to the binary trace.
+ */
+static _Thread_local uint8_t hookinstructionannounced[HOOKINSTRUCTION_CAPACITY];
+static _Thread_local uint8_t hookimmnameannounced[HOOKIMMNAME_CAPACITY];
+
+static inline const char *instructionName(const HookEvent_t *event) {
+    if (event->instructionid < HOOKINSTRUCTION_COUNT) {
+        return hookformat[event->instructionid].name;
+    }
+    if (event->instructionid < hookinstructioncount) {
+        return hookinstructionname[event->instructionid - HOOKINSTRUCTION_COUNT];
+    }
+    return hookformat[HOOKINSTRUCTION_UNKNOWN].name;
+}
+
+static inline const char *immediateName(const HookEvent_t *event) {
+    if (event->immnameid < hookimmnamecount) {
+        return hookimmname[event->immnameid];
+    }
+    return hookimmname[0];
+}
+
+uint16_t HookInternInstruction(const char *instruction) {
+    if (instruction == NULL ||
+        instruction[0] == '\0') {
+        return HOOKINSTRUCTION_UNSET;
+    }
+
+    for (uint16_t i = HOOKINSTRUCTION_UNKNOWN + 1; i < HOOKINSTRUCTION_COUNT; i++) {
+        if (strcmp(instruction, hookformat[i].name) == 0) {
+            return i;
         }
     }
 
-    if (strcmp(context->instruction, "csrrwi") == 0 ||
-        strcmp(context->instruction, "csrrsi") == 0 ||
-        strcmp(context->instruction, "csrrci") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            printInteger(immname, imm, immlength, immissigned);
-            printf(", csr 0x%04X(%s): 0x%08X\n",
-                   csrnum,
-                   csrname,
-                   *(uint32_t *)csr);
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%s%s = 0x%08X\n",
-                   tab,
-                   csrname,
-                   *(uint32_t *)csr);
-            if (rdnum != 0) {
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            }
-            return;
+    for (uint16_t i = HOOKINSTRUCTION_COUNT; i < hookinstructioncount; i++) {
+        if (strcmp(instruction, hookinstructionname[i - HOOKINSTRUCTION_COUNT]) == 0) {
+            return i;
         }
     }
-#endif
 
-    /**
-     * S-type, Compressed Store instructions.
-     *
-     * prints rs1, rs2, imm and memory location.
-     */
+    if (hookinstructioncount >= HOOKINSTRUCTION_CAPACITY) {
+        return HOOKINSTRUCTION_UNKNOWN;
+    }
 
-    if (strcmp(context->instruction, "sb") == 0 ||
-        strcmp(context->instruction, "sh") == 0 ||
-        strcmp(context->instruction, "sw") == 0 ||
-        strcmp(context->instruction, "c.sw") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rs1 x%u(%s): 0x%08X, rs2 x%u(%s): 0x%08X",
-                   context->instruction,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1,
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            printInteger(immname, imm, immlength, immissigned);
-            printf(", memorylocation: 0x%08X\n",
-                   memorylocation);
-            return;
-        } else if (context->hook == HOOK_END) {
-            if (length == 1) {
-                printf("%s0x%08X = 0x%02X\n",
-                       tab,
-                       memorylocation,
-                       *(uint8_t *)rs2);
-            } else if (length == 2) {
-                printf("%s0x%08X = 0x%04X\n",
-                       tab,
-                       memorylocation,
-                       *(uint16_t *)rs2);
-            } else {
-                printf("%s0x%08X = 0x%08X\n",
-                       tab,
-                       memorylocation,
-                       *(uint32_t *)rs2);
-            }
-            return;
-        }
+    char *name = strdup(instruction);
+    if (name == NULL) {
+        return HOOKINSTRUCTION_UNKNOWN;
     }
+    hookinstructionname[hookinstructioncount - HOOKINSTRUCTION_COUNT] = name;
+    return hookinstructioncount++;
+}
 
-    /**
-     * B-type pseudoinstructions.
-     */
+uint8_t HookInternImmediateName(const char *immname) {
+    if (immname == NULL) {
+        return 0;
+    }
 
-    // Detect BEQZ
-    if (strcmp(context->instruction, "beq") == 0 &&
-        rs2num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", beqz, rs1 x%u(%s): 0x%08X",
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
+    for (uint8_t i = 0; i < hookimmnamecount; i++) {
+        if (strcmp(immname, hookimmname[i]) == 0) {
+            return i;
         }
     }
 
-    // Detect BNEZ
-    if (strcmp(context->instruction, "bne") == 0 &&
-        rs2num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", bnez, rs1 x%u(%s): 0x%08X",
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        }
+    if (hookimmnamecount >= HOOKIMMNAME_CAPACITY) {
+        return 0;
     }
 
-    // Detect BGEZ
-    if (strcmp(context->instruction, "bge") == 0 &&
-        rs2num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", bgez, rs1 x%u(%s): 0x%08X",
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        }
+    char *name = strdup(immname);
+    if (name == NULL) {
+        return 0;
     }
+    hookimmname[hookimmnamecount] = name;
+    return hookimmnamecount++;
+}
 
-    // Detect BLTZ
-    if (strcmp(context->instruction, "blt") == 0 &&
-        rs2num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", bltz, rs1 x%u(%s): 0x%08X",
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
+// Power of two.
+#define HOOKCACHE_SIZE 512
+
+/**
+ * Maps the address of a string given by the emulator to its identifier.
+ *
+ * The emulator passes string literals, so the address identifies the string.
+ * The string compare happens only the first time an address is seen.
+ */
+typedef struct {
+    const char *string;
+    uint16_t id;
+} HookCacheEntry_t;
+
+static _Thread_local HookCacheEntry_t hookinstructioncache[HOOKCACHE_SIZE];
+static _Thread_local HookCacheEntry_t hookimmnamecache[HOOKCACHE_SIZE];
+
+static inline uint32_t cacheSlot(const char *string) {
+    return (uint32_t)(((uintptr_t)string * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (HOOKCACHE_SIZE - 1);
+}
+
+static uint16_t getInstructionId(const char *instruction) {
+    uint32_t slot = cacheSlot(instruction);
+
+    for (uint32_t probe = 0; probe < HOOKCACHE_SIZE; probe++) {
+        if (hookinstructioncache[slot].string == instruction) {
+            return hookinstructioncache[slot].id;
         }
-    }
 
-    // Detect BLEZ
-    if (strcmp(context->instruction, "bge") == 0 &&
-        rs1num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", blez, rs2 x%u(%s): 0x%08X",
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
+        if (hookinstructioncache[slot].string == NULL) {
+            break;
         }
+
+        slot = (slot + 1) & (HOOKCACHE_SIZE - 1);
     }
 
-    // Detect BGTZ
-    if (strcmp(context->instruction, "blt") == 0 &&
-        rs1num == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", bgtz, rs2 x%u(%s): 0x%08X",
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        }
+    uint16_t instructionid = HookInternInstruction(instruction);
+
+    if (instruction != NULL &&
+        hookinstructioncache[slot].string == NULL) {
+        hookinstructioncache[slot].string = instruction;
+        hookinstructioncache[slot].id = instructionid;
     }
 
-    /**
-     * B-type instructions.
-     *
-     * prints rs1, rs2, and imm.
-     */
+    if (hookoutput == HOOKOUTPUT_BINARY &&
+        instructionid != HOOKINSTRUCTION_UNSET &&
+        !hookinstructionannounced[instructionid]) {
+        hookinstructionannounced[instructionid] = 1;
+        TraceWriteName(TRACE_RECORD_INSTRUCTIONNAME, instructionid, instruction);
+    }
 
-    if (strcmp(context->instruction, "beq") == 0 ||
-        strcmp(context->instruction, "bne") == 0 ||
-        strcmp(context->instruction, "bge") == 0 ||
-        strcmp(context->instruction, "bgeu") == 0 ||
-        strcmp(context->instruction, "blt") == 0 ||
-        strcmp(context->instruction, "bltu") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rs1 x%u(%s): 0x%08X, rs2 x%u(%s): 0x%08X",
-                   context->instruction,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1,
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%spc = 0x%08X\n",
-                   tab,
-                   state->programcounternext);
-            return;
-        }
+    return instructionid;
+}
+
+static uint8_t getImmediateNameId(const char *immname) {
+    if (immname == NULL) {
+        immname = hookimmname[0];
     }
 
-    /**
-     * U-type instructions.
-     *
-     * prints rd and imm.
-     */
+    uint32_t slot = cacheSlot(immname);
 
-    if (strcmp(context->instruction, "lui") == 0 ||
-        strcmp(context->instruction, "auipc") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            if (rdnum != 0) {
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            }
-            return;
+    for (uint32_t probe = 0; probe < HOOKCACHE_SIZE; probe++) {
+        if (hookimmnamecache[slot].string == immname) {
+            return hookimmnamecache[slot].id;
         }
+
+        if (hookimmnamecache[slot].string == NULL) {
+            break;
+        }
+
+        slot = (slot + 1) & (HOOKCACHE_SIZE - 1);
     }
 
-    /**
-     * J-type pseudoinstructions.
-     */
+    uint8_t immnameid = HookInternImmediateName(immname);
 
-    // Detect J
-    if (strcmp(context->instruction, "jal") == 0) {
-        if (rdnum == 0) {
-            if (context->hook == HOOK_BEGIN) {
-                printf(", j");
-                printInteger(immname, imm, immlength, immissigned);
-                printf("\n");
-                return;
-            }
-        }
+    if (hookimmnamecache[slot].string == NULL) {
+        hookimmnamecache[slot].string = immname;
+        hookimmnamecache[slot].id = immnameid;
     }
 
-    /**
-     * J-type instructions.
-     *
-     * prints rd and imm.
-     */
+    if (hookoutput == HOOKOUTPUT_BINARY &&
+        !hookimmnameannounced[immnameid]) {
+        hookimmnameannounced[immnameid] = 1;
+        TraceWriteName(TRACE_RECORD_IMMNAME, immnameid, immname);
+    }
 
-    if (strcmp(context->instruction, "jal") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            if (rdnum != 0) {
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-                printf("%spc = 0x%08X\n",
-                       tab,
-                       state->programcounternext);
-            }
-            return;
-        }
+    return immnameid;
+}
+
+/**
+ * Copies the values the formatters need out of the emulator state and hook context.
+ */
+static inline void captureEvent(
+    HookEvent_t *event,
+    const RiscvEmulatorState_t *state,
+    const RiscvEmulatorHookContext_t *context) {
+
+    event->hook = context->hook;
+    event->instructionid = getInstructionId(context->instruction);
+
+    event->programcounter = state->programcounter;
+    event->programcounternext = state->programcounternext;
+    event->instruction = state->instruction.value;
+    event->compressed = 0;
+#if (RVE_E_C == 1)
+    event->compressed = state->instruction.copcode.op != OPCODE16_QUADRANT_INVALID;
+#endif
+
+    event->rdnum = context->rdnum;
+    event->rd = context->rd != NULL ? *(uint32_t *)context->rd : 0;
+    event->rs1num = context->rs1num;
+    event->rs1 = context->rs1 != NULL ? *(uint32_t *)context->rs1 : 0;
+    event->rs2num = context->rs2num;
+    event->rs2 = context->rs2 != NULL ? *(uint32_t *)context->rs2 : 0;
+
+    event->imm = context->imm;
+    event->immissigned = context->immissigned;
+    event->immnameid = getImmediateNameId(context->immname);
+    event->immlength = context->immlength != 0 ? context->immlength : 4;
+
+    event->memorylocation = context->memorylocation;
+    event->length = context->length;
+
+    event->ra = state->reg.ra;
+    event->sp = state->reg.sp;
+
+#if (RVE_E_ZICSR == 1)
+    event->csrnum = context->csrnum;
+    event->csr = context->csr != NULL ? *(uint32_t *)context->csr : 0;
+
+    if (event->instructionid == HOOKINSTRUCTION_TRAP) {
+        event->mcauseinterrupt = state->csr.mcause.interrupt;
+        event->mcauseexceptioncode = state->csr.mcause.exceptioncode;
+        event->mtval = state->csr.mtval;
+        event->mstatusmpp = state->csr.mstatus.mpp;
+        event->mstatusmpie = state->csr.mstatus.mpie;
+        event->mstatusmie = state->csr.mstatus.mie;
+        event->mepc = state->csr.mepc;
     }
+#endif
+}
 
-    /**
-     * Compressed Register instructions.
-     * Compressed Arithmetic instructions.
-     */
+void HookPrintEvent(FILE *out, const HookEvent_t *event) {
+    if (event->hook == HOOK_UNKNOWN ||
+        event->hook == HOOK_BEGIN) {
+        fprintf(out, "pc: 0x%08X%s", event->programcounter, SymbolsDescribe(hooksymbols, event->programcounter));
 
-    if (strcmp(context->instruction, "c.add") == 0 ||
-        strcmp(context->instruction, "c.sub") == 0 ||
-        strcmp(context->instruction, "c.xor") == 0 ||
-        strcmp(context->instruction, "c.or") == 0 ||
-        strcmp(context->instruction, "c.and") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rs1/rd x%u(%s): 0x%08X, rs2 x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%sx%u(%s) = 0x%08X\n",
-                   tab,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            return;
+        if (event->compressed) {
+            fprintf(out, ", instruction:     0x%04X", (uint16_t)event->instruction);
+        } else {
+            fprintf(out, ", instruction: 0x%08X", event->instruction);
         }
-    }
 
-    if (strcmp(context->instruction, "c.mv") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X, rs2 x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%sx%u(%s) = 0x%08X\n",
-                   tab,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
+        if (event->instructionid == HOOKINSTRUCTION_UNSET) {
+            fprintf(out, ", ??? instruction string not set");
             return;
         }
     }
 
-    if (strcmp(context->instruction, "c.jr") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rs1 x%u(%s): 0x%08X\n",
-                   context->instruction,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%spc = 0x%08X\n",
-                   tab,
-                   state->programcounternext);
-            return;
-        }
+    if (event->instructionid == HOOKINSTRUCTION_UNSET) {
+        return;
     }
 
-    if (strcmp(context->instruction, "c.jalr") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, x1(ra): 0x%08X, rs1 x%u(%s): 0x%08X\n",
-                   context->instruction,
-                   *(uint32_t *)ra,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%sx1(ra) = 0x%08X\n",
-                   tab,
-                   *(uint32_t *)ra);
-            printf("%spc = 0x%08X\n",
-                   tab,
-                   state->programcounternext);
+    if (event->instructionid < HOOKINSTRUCTION_COUNT) {
+        HookFormatter_t formatter = hookformat[event->instructionid].formatter;
+        if (formatter != NULL &&
+            formatter(out, event)) {
             return;
         }
     }
 
     /**
-     * Compressed Immediate instructions.
+     * Fallback prints. When hitting this, please add the instruction to hookformat.
      */
 
-    if (strcmp(context->instruction, "c.li") == 0 ||
-        strcmp(context->instruction, "c.lui") == 0 ||
-        strcmp(context->instruction, "c.addi") == 0 ||
-        strcmp(context->instruction, "c.addi16sp") == 0 ||
-        strcmp(context->instruction, "c.slli") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%sx%u(%s) = 0x%08X\n",
-                   tab,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            return;
-        }
+    if (event->hook == HOOK_BEGIN ||
+        event->hook == HOOK_UNKNOWN) {
+        fprintf(out, ", ");
     }
+    if (event->hook == HOOK_END) {
+        fprintf(out, "%s", tab);
+    }
+    fprintf(out, "%s ??? hook %d\n",
+            instructionName(event),
+            event->hook);
+}
 
-    /**
-     * Compressed Stack-relative Store instructions.
-     */
+int HookSetOutput(HookOutput_t output, const char *path) {
+    if (output == HOOKOUTPUT_BINARY &&
+        TraceOpen(path, hooklog != NULL ? hooklog : stdout) != 0) {
+        return 1;
+    }
 
-    if (strcmp(context->instruction, "c.swsp") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rs2 x%u(%s): 0x%08X, sp: 0x%08X",
-                   context->instruction,
-                   rs2num,
-                   rs2name,
-                   *(uint32_t *)rs2,
-                   *(uint32_t *)sp);
-            printInteger(immname, imm, immlength, immissigned);
-            printf(", memorylocation: 0x%08X\n",
-                   memorylocation);
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%s0x%08X = 0x%08X\n",
-                   tab,
-                   memorylocation,
-                   *(uint32_t *)rs2);
-            return;
-        }
+    if (output == HOOKOUTPUT_BINARY) {
+        // A new trace file needs all names again. Only a miss in the caches announces a name, so they start over too.
+        memset(hookinstructionannounced, 0, sizeof(hookinstructionannounced));
+        memset(hookimmnameannounced, 0, sizeof(hookimmnameannounced));
+        memset(hookinstructioncache, 0, sizeof(hookinstructioncache));
+        memset(hookimmnamecache, 0, sizeof(hookimmnamecache));
     }
 
-    /**
-     * Compressed Wide Immediate instructions.
-     */
+    hookoutput = output;
+    return 0;
+}
 
-    if (strcmp(context->instruction, "c.addi4spn") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X, sp: 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   *(uint32_t *)sp);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            if (rdnum != 0) {
-                printf("%sx%u(%s) = 0x%08X\n",
-                       tab,
-                       rdnum,
-                       rdname,
-                       *(uint32_t *)rd);
-            }
-            return;
-        }
+void HookSetLog(FILE *log) {
+    hooklog = log;
+}
+
+void HookSetSymbols(SymbolTable_t *symbols) {
+    hooksymbols = symbols;
+}
+
+int HookSetRing(size_t events) {
+    if (events == 0) {
+        return 1;
     }
 
-    /**
-     * Compressed Load instructions.
-     */
+    hookring = calloc(events, sizeof(HookEvent_t));
+    if (hookring == NULL) {
+        fprintf(hooklog != NULL ? hooklog : stdout, "Not enough memory for %zu hook events.\n", events);
+        return 1;
+    }
 
-    if (strcmp(context->instruction, "c.lwsp") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X, sp: 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   *(uint32_t *)sp);
-            printInteger(immname, imm, immlength, immissigned);
-            printf(", memorylocation: 0x%08X\n",
-                   memorylocation);
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%sx%u(%s) = 0x%08X\n",
-                   tab,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            return;
-        }
+    hookringsize = events;
+    hookringnext = 0;
+    hookringcount = 0;
+    hookoutput = HOOKOUTPUT_RING;
+    return 0;
+}
+
+void HookDumpRing(FILE *out) {
+    if (hookring == NULL) {
+        return;
     }
 
-    if (strcmp(context->instruction, "c.lw") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X, rs1 x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf(", memorylocation: 0x%08X\n",
-                   memorylocation);
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%sx%u(%s) = 0x%08X\n",
-                   tab,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            return;
+    fprintf(out, "Last %zu hook events:\n", hookringcount);
+
+    size_t index = hookringcount < hookringsize ? 0 : hookringnext;
+    for (size_t i = 0; i < hookringcount; i++) {
+        HookPrintEvent(out, &hookring[index]);
+        if (++index == hookringsize) {
+            index = 0;
         }
     }
+}
 
-    /**
-     * Compressed Branch instructions.
-     */
+int HookSetProfile(void) {
+    hookprofile = calloc(HOOKINSTRUCTION_CAPACITY, sizeof(uint64_t));
+    if (hookprofile == NULL) {
+        return 1;
+    }
 
-    if (strcmp(context->instruction, "c.srli") == 0 ||
-        strcmp(context->instruction, "c.srai") == 0 ||
-        strcmp(context->instruction, "c.andi") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rd x%u(%s): 0x%08X",
-                   context->instruction,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%sx%u(%s) = 0x%08X\n",
-                   tab,
-                   rdnum,
-                   rdname,
-                   *(uint32_t *)rd);
-            return;
-        }
+    if (hookoutput == HOOKOUTPUT_TEXT) {
+        hookoutput = HOOKOUTPUT_NONE;
     }
+    return 0;
+}
 
-    if (strcmp(context->instruction, "c.beqz") == 0 ||
-        strcmp(context->instruction, "c.bnez") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, rs1 x%u(%s): 0x%08X",
-                   context->instruction,
-                   rs1num,
-                   rs1name,
-                   *(uint32_t *)rs1);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%spc = 0x%08X\n",
-                   tab,
-                   state->programcounternext);
-            return;
+void HookForEachProfiled(void (*visit)(const char *name, uint64_t count, void *argument), void *argument) {
+    if (hookprofile == NULL) {
+        return;
+    }
+
+    for (uint16_t id = HOOKINSTRUCTION_UNKNOWN; id < hookinstructioncount; id++) {
+        if (hookprofile[id] != 0) {
+            HookEvent_t event = {.instructionid = id};
+            visit(instructionName(&event), hookprofile[id], argument);
         }
     }
+}
 
-    /**
-     * Compressed Jump instructions.
-     */
+void HookSetListener(void (*listener)(const HookEvent_t *event, void *argument), void *argument) {
+    hooklistener = listener;
+    hooklistenerargument = argument;
 
-    if (strcmp(context->instruction, "c.jal") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s, x1(ra): 0x%08X",
-                   context->instruction,
-                   *(uint32_t *)ra);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%sx1(ra) = 0x%08X\n",
-                   tab,
-                   *(uint32_t *)ra);
-            printf("%spc = 0x%08X\n",
-                   tab,
-                   state->programcounternext);
-            return;
-        }
+    if (listener != NULL &&
+        hookoutput == HOOKOUTPUT_TEXT) {
+        hookoutput = HOOKOUTPUT_NONE;
     }
+}
 
-    if (strcmp(context->instruction, "c.j") == 0) {
-        if (context->hook == HOOK_BEGIN) {
-            printf(", %s",
-                   context->instruction);
-            printInteger(immname, imm, immlength, immissigned);
-            printf("\n");
-            return;
-        } else if (context->hook == HOOK_END) {
-            printf("%spc = 0x%08X\n",
-                   tab,
-                   state->programcounternext);
-            return;
-        }
+void HookClose(void) {
+    // Does nothing without a trace.
+    TraceClose();
+    free(hookring);
+    hookring = NULL;
+    free(hookprofile);
+    hookprofile = NULL;
+    hooksymbols = NULL;
+    hooklistener = NULL;
+    hooklistenerargument = NULL;
+    hookoutput = HOOKOUTPUT_TEXT;
+}
+
+/**
+ * Debug prints.
+ */
+void RiscvEmulatorHook(
+    const RiscvEmulatorState_t *state,
+    const RiscvEmulatorHookContext_t *context) {
+
+    if (hookprofile != NULL &&
+        (context->hook == HOOK_BEGIN || context->hook == HOOK_UNKNOWN)) {
+        hookprofile[getInstructionId(context->instruction)]++;
     }
 
-    /**
-     * Not instructions. Like trap.
-     */
+    if (hooklistener != NULL) {
+        HookEvent_t event = {0};
+        captureEvent(&event, state, context);
+        hooklistener(&event, hooklistenerargument);
+    }
 
-#if (RVE_E_ZICSR == 1)
-    if (strcmp(context->instruction, "_trap") == 0) {
-        const char *causedescription = RiscvEmulatorGetMcauseException(
-            state->csr.mcause.interrupt,
-            state->csr.mcause.exceptioncode);
-
-        printf(", trap, interrupt: %d, exception code %d: %s\n",
-               state->csr.mcause.interrupt,
-               state->csr.mcause.exceptioncode,
-               causedescription);
-        printf("%smtval = 0x%08X\n",
-               tab,
-               state->csr.mtval);
-        printf("%smstatus.mpp = %d\n",
-               tab,
-               state->csr.mstatus.mpp);
-        printf("%smstatus.mpie = %d\n",
-               tab,
-               state->csr.mstatus.mpie);
-        printf("%smstatus.mie = %d\n",
-               tab,
-               state->csr.mstatus.mie);
-        printf("%smepc = 0x%08X\n",
-               tab,
-               state->csr.mepc);
-        printf("%spc = 0x%08X\n",
-               tab,
-               state->programcounternext);
+    if (hookoutput == HOOKOUTPUT_NONE) {
+        return;
+    }
 
+    if (hookoutput == HOOKOUTPUT_RING) {
+        captureEvent(&hookring[hookringnext], state, context);
+        if (++hookringnext == hookringsize) {
+            hookringnext = 0;
+        }
+        if (hookringcount < hookringsize) {
+            hookringcount++;
+        }
         return;
     }
-#endif
 
-    /**
-     * Fallback prints. When hitting this, please add the instruction somewhere above.
-     */
+    HookEvent_t event = {0};
+    captureEvent(&event, state, context);
 
-    if (context->hook == HOOK_BEGIN ||
-        context->hook == HOOK_UNKNOWN) {
-        printf(", ");
-    }
-    if (context->hook == HOOK_END) {
-        printf("%s", tab);
+    if (hookoutput == HOOKOUTPUT_BINARY) {
+        TraceWriteEvent(&event);
+    } else {
+        HookPrintEvent(hooklog != NULL ? hooklog : stdout, &event);
     }
-    printf("%s ??? hook %d\n",
-           context->instruction,
-           context->hook);
 }
-
-#pragma GCC diagnostic pop
\ No newline at end of file
@@ -0,0 +1,81 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+// MAP_ANONYMOUS is not part of POSIX.
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image.h"
+
+uint8_t *ImageAllocate(size_t length) {
+    void *region = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+        return NULL;
+    }
+    return region;
+}
+
+void ImageFree(uint8_t *region, size_t length) {
+    if (region != NULL) {
+        munmap(region, length);
+    }
+}
+
+/**
+ * Reads the whole file, read() may return less than asked.
+ */
+static size_t readImage(int fd, uint8_t *region, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t result = read(fd, &region[done], size - done);
+        if (result <= 0) {
+            break;
+        }
+        done += result;
+    }
+    return done;
+}
+
+int ImageLoad(const char *path, uint8_t *region, size_t length, uint8_t map, size_t *size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    *size = (size_t)status.st_size < length ? (size_t)status.st_size : length;
+
+    if (map &&
+        *size > 0) {
+        // The tail of the last page after the end of the file reads as zero, like the rest of the region.
+        size_t pagesize = sysconf(_SC_PAGESIZE);
+        size_t maplength = (*size + pagesize - 1) & ~(pagesize - 1);
+        if (maplength > length) {
+            maplength = length;
+        }
+
+        void *mapped = mmap(region, maplength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0);
+        if (mapped != MAP_FAILED) {
+            close(fd);
+            return 0;
+        }
+        // Not every file can be mapped, reading still works.
+    }
+
+    *size = readImage(fd, region, *size);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,249 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <string.h>
+
+#include <RiscvEmulatorDefineHook.h>
+
+#include "instance.h"
+#include "lockstep.h"
+#include "lockstepparse.h"
+
+/**
+ * Reads the next line of the reference into line, without the newline. Returns 0 at the end of the log.
+ */
+static uint8_t readLine(Lockstep_t *lockstep) {
+    if (fgets(lockstep->line, sizeof(lockstep->line), lockstep->reference) == NULL) {
+        return 0;
+    }
+    lockstep->linenumber++;
+
+    size_t length = strlen(lockstep->line);
+    if (length > 0 &&
+        lockstep->line[length - 1] == '\n') {
+        lockstep->line[length - 1] = '\0';
+    } else {
+        // Only the start of a long line is looked at.
+        int c;
+        while ((c = getc(lockstep->reference)) != EOF &&
+               c != '\n') {
+        }
+    }
+    return 1;
+}
+
+/**
+ * Reads the next instruction of the reference. Returns 0 on success, 1 at the end of the log.
+ */
+static uint8_t readRecord(Lockstep_t *lockstep, LockstepRecord_t *record) {
+    memset(record, 0, sizeof(LockstepRecord_t));
+
+    LockstepFormat_t format = LOCKSTEP_FORMAT_NONE;
+    const char *writes = NULL;
+    while (format == LOCKSTEP_FORMAT_NONE) {
+        if (!lockstep->pending &&
+            !readLine(lockstep)) {
+            return 1;
+        }
+        lockstep->pending = 0;
+        format = LockstepParseStart(lockstep->line, &record->programcounter, &writes);
+    }
+
+    memcpy(lockstep->context[lockstep->contextnext], lockstep->line, LOCKSTEP_LINE_LENGTH);
+    if (++lockstep->contextnext == LOCKSTEP_CONTEXT) {
+        lockstep->contextnext = 0;
+    }
+    if (lockstep->contextcount < LOCKSTEP_CONTEXT) {
+        lockstep->contextcount++;
+    }
+
+    if (format == LOCKSTEP_FORMAT_SPIKE) {
+        LockstepParseSpikeWrites(writes, record);
+        return 0;
+    }
+
+    // A Sail instruction goes on until the next one starts, that line is kept for the next call.
+    uint32_t programcounter;
+    while (readLine(lockstep)) {
+        if (LockstepParseStart(lockstep->line, &programcounter, &writes) != LOCKSTEP_FORMAT_NONE) {
+            lockstep->pending = 1;
+            break;
+        }
+        LockstepParseSailWrite(lockstep->line, record);
+    }
+    return 0;
+}
+
+/**
+ * Takes what an instruction changed from its last hook event.
+ */
+static void describeEvent(const HookEvent_t *event, LockstepRecord_t *record) {
+    memset(record, 0, sizeof(LockstepRecord_t));
+    record->programcounter = event->programcounter;
+
+    switch (event->instructionid) {
+        case HOOKINSTRUCTION_SB:
+        case HOOKINSTRUCTION_SH:
+        case HOOKINSTRUCTION_SW:
+        case HOOKINSTRUCTION_C_SW:
+        case HOOKINSTRUCTION_C_SWSP: {
+            record->hasstore = 1;
+            record->length = event->length;
+            record->memorylocation = event->memorylocation;
+            record->value = event->length >= 4 ? event->rs2 : event->rs2 & ((UINT32_C(1) << (event->length * 8)) - 1);
+            break;
+        }
+        case HOOKINSTRUCTION_BEQ:
+        case HOOKINSTRUCTION_BNE:
+        case HOOKINSTRUCTION_BGE:
+        case HOOKINSTRUCTION_BGEU:
+        case HOOKINSTRUCTION_BLT:
+        case HOOKINSTRUCTION_BLTU:
+        case HOOKINSTRUCTION_C_BEQZ:
+        case HOOKINSTRUCTION_C_BNEZ:
+        case HOOKINSTRUCTION_C_J:
+        case HOOKINSTRUCTION_C_JR:
+        case HOOKINSTRUCTION_FENCE:
+        case HOOKINSTRUCTION_FENCEI:
+        case HOOKINSTRUCTION_MRET: {
+            break;
+        }
+        default: {
+            // Writes to x0 are not in the reference either.
+            record->hasrd = event->rdnum != 0;
+            record->rdnum = event->rdnum;
+            record->rd = event->rd;
+            break;
+        }
+    }
+}
+
+/**
+ * Returns 1 when both sides retired the same instruction with the same writes.
+ */
+static uint8_t sameRecord(const LockstepRecord_t *expected, const LockstepRecord_t *actual) {
+    uint32_t mask = actual->length >= 4 ? UINT32_MAX : (UINT32_C(1) << (actual->length * 8)) - 1;
+
+    return expected->programcounter == actual->programcounter &&
+           expected->hasrd == actual->hasrd &&
+           (!actual->hasrd || (expected->rdnum == actual->rdnum && expected->rd == actual->rd)) &&
+           expected->hasstore == actual->hasstore &&
+           (!actual->hasstore ||
+            (expected->memorylocation == actual->memorylocation && (expected->value & mask) == (actual->value & mask)));
+}
+
+static void printRecord(FILE *out, const char *side, const LockstepRecord_t *record) {
+    fprintf(out, "%s pc: 0x%08X", side, record->programcounter);
+    if (record->hasrd) {
+        fprintf(out, ", x%u = 0x%08X", record->rdnum, record->rd);
+    }
+    if (record->hasstore) {
+        fprintf(out, ", 0x%08X = 0x%08X", record->memorylocation, record->value);
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * Prints both sides of a divergence and what came before it in the reference.
+ */
+static void printDivergence(
+    Lockstep_t *lockstep,
+    const HookEvent_t *event,
+    const LockstepRecord_t *expected,
+    const LockstepRecord_t *actual) {
+
+    FILE *log = lockstep->log;
+    fprintf(log, "Diverged from the reference after %llu instructions, at line %llu of the reference log.\n",
+            (unsigned long long)lockstep->compared,
+            (unsigned long long)lockstep->linenumber);
+    printRecord(log, "Reference", expected);
+    printRecord(log, "Emulator ", actual);
+
+    fprintf(log, "The reference up to there:\n");
+    size_t index = lockstep->contextcount < LOCKSTEP_CONTEXT ? 0 : lockstep->contextnext;
+    for (size_t i = 0; i < lockstep->contextcount; i++) {
+        fprintf(log, "%s\n", lockstep->context[index]);
+        if (++index == LOCKSTEP_CONTEXT) {
+            index = 0;
+        }
+    }
+
+    fprintf(log, "The instruction in the emulator:\n");
+    if (event->hook == HOOK_END) {
+        HookPrintEvent(log, &lockstep->begin);
+    }
+    HookPrintEvent(log, event);
+}
+
+int LockstepOpen(Lockstep_t *lockstep, const char *path, FILE *log) {
+    memset(lockstep, 0, sizeof(Lockstep_t));
+    lockstep->log = log;
+
+    lockstep->reference = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (lockstep->reference == NULL) {
+        fprintf(log, "Cannot open %s.\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+void LockstepEvent(Lockstep_t *lockstep, const HookEvent_t *event) {
+    if (lockstep->done) {
+        return;
+    }
+
+    if (event->hook == HOOK_BEGIN) {
+        lockstep->begin = *event;
+        return;
+    }
+    if (event->hook != HOOK_END) {
+        // A trap is not an instruction, and the reference does not retire instructions that trap.
+        if (event->instructionid == HOOKINSTRUCTION_TRAP ||
+            event->instructionid == HOOKINSTRUCTION_ECALL ||
+            event->instructionid == HOOKINSTRUCTION_EBREAK) {
+            return;
+        }
+    }
+
+    LockstepRecord_t actual;
+    describeEvent(event, &actual);
+
+    LockstepRecord_t expected;
+    do {
+        if (readRecord(lockstep, &expected) != 0) {
+            fprintf(lockstep->log, "The reference log ends after %llu instructions, the rest is not compared.\n",
+                    (unsigned long long)lockstep->compared);
+            lockstep->done = 1;
+            return;
+        }
+    } while (!lockstep->synchronized &&
+             expected.programcounter != actual.programcounter);
+    lockstep->synchronized = 1;
+
+    if (!sameRecord(&expected, &actual)) {
+        printDivergence(lockstep, event, &expected, &actual);
+        lockstep->done = 1;
+        instance->pleasestop = STOP_DIVERGED;
+        return;
+    }
+    lockstep->compared++;
+}
+
+void LockstepClose(Lockstep_t *lockstep) {
+    if (lockstep->reference == NULL) {
+        return;
+    }
+
+    if (!lockstep->done) {
+        fprintf(lockstep->log, "Compared %llu instructions with the reference.\n",
+                (unsigned long long)lockstep->compared);
+    }
+    if (lockstep->reference != stdin) {
+        fclose(lockstep->reference);
+    }
+    lockstep->reference = NULL;
+}
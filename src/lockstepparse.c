@@ -0,0 +1,159 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lockstepparse.h"
+
+/**
+ * Skips spaces and reads a hexadecimal number that starts with 0x. Returns NULL when there is none, else the end.
+ */
+static const char *parseHex(const char *text, uint32_t *value) {
+    while (*text == ' ' ||
+           *text == '\t') {
+        text++;
+    }
+    if (text[0] != '0' ||
+        (text[1] != 'x' && text[1] != 'X')) {
+        return NULL;
+    }
+
+    char *end;
+    // 64-bit models print sign-extended addresses, the low half is the 32-bit one.
+    *value = (uint32_t)strtoull(text, &end, 16);
+    return end;
+}
+
+LockstepFormat_t LockstepParseStart(const char *line, uint32_t *programcounter, const char **writes) {
+    while (*line == ' ') {
+        line++;
+    }
+
+    if (strncmp(line, "core", 4) == 0) {
+        // core   0: 3 0x80000000 (0x00000297) x5 0x80000000, without the privilege level it is a -l line.
+        const char *text = strchr(line, ':');
+        if (text == NULL) {
+            return LOCKSTEP_FORMAT_NONE;
+        }
+        text++;
+        while (*text == ' ') {
+            text++;
+        }
+        if (!isdigit((unsigned char)text[0]) ||
+            text[1] != ' ') {
+            return LOCKSTEP_FORMAT_NONE;
+        }
+
+        text = parseHex(text + 2, programcounter);
+        if (text == NULL) {
+            return LOCKSTEP_FORMAT_NONE;
+        }
+        const char *instruction = strchr(text, ')');
+        *writes = instruction != NULL ? instruction + 1 : text;
+        return LOCKSTEP_FORMAT_SPIKE;
+    }
+
+    if (line[0] == '[') {
+        // [0] [M]: 0x80000000 (0x00000297) auipc t0, 0
+        const char *text = strstr(line, "]: ");
+        if (text == NULL ||
+            parseHex(text + 3, programcounter) == NULL) {
+            return LOCKSTEP_FORMAT_NONE;
+        }
+        return LOCKSTEP_FORMAT_SAIL;
+    }
+
+    return LOCKSTEP_FORMAT_NONE;
+}
+
+void LockstepParseSpikeWrites(const char *text, LockstepRecord_t *record) {
+    while (*text != '\0') {
+        while (*text == ' ') {
+            text++;
+        }
+        const char *token = text;
+        while (*text != ' ' &&
+               *text != '\0') {
+            text++;
+        }
+        if (token == text) {
+            break;
+        }
+
+        uint32_t value;
+        if (token[0] == 'x' &&
+            isdigit((unsigned char)token[1])) {
+            const char *end = parseHex(text, &value);
+            unsigned num = strtoul(token + 1, NULL, 10);
+            if (end != NULL &&
+                num != 0) {
+                record->hasrd = 1;
+                record->rdnum = num;
+                record->rd = value;
+            }
+            text = end != NULL ? end : text;
+        } else if (text - token == 3 &&
+                   strncmp(token, "mem", 3) == 0) {
+            uint32_t address;
+            const char *end = parseHex(text, &address);
+            if (end == NULL) {
+                continue;
+            }
+            text = end;
+
+            // A load only has the address.
+            end = parseHex(text, &value);
+            if (end != NULL) {
+                record->hasstore = 1;
+                record->memorylocation = address;
+                record->value = value;
+                text = end;
+            }
+        } else {
+            // The value of a CSR or floating point register.
+            const char *end = parseHex(text, &value);
+            text = end != NULL ? end : text;
+        }
+    }
+}
+
+void LockstepParseSailWrite(const char *line, LockstepRecord_t *record) {
+    while (*line == ' ') {
+        line++;
+    }
+
+    unsigned num;
+    uint32_t value;
+    const char *arrow = strstr(line, "<-");
+    if (arrow == NULL ||
+        parseHex(arrow + 2, &value) == NULL) {
+        return;
+    }
+
+    if (sscanf(line, "x%u <-", &num) == 1) {
+        if (num != 0) {
+            record->hasrd = 1;
+            record->rdnum = num;
+            record->rd = value;
+        }
+    } else if (strncmp(line, "mem[", 4) == 0) {
+        // Some versions put the kind of access before the address, mem[W,0x80001000].
+        const char *address = line + 4;
+        const char *comma = strchr(address, ',');
+        if (comma != NULL &&
+            comma < arrow) {
+            address = comma + 1;
+        }
+        if (parseHex(address, &record->memorylocation) != NULL) {
+            record->hasstore = 1;
+            record->value = value;
+        }
+    }
+}
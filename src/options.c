@@ -0,0 +1,526 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <RiscvEmulatorDefine.h>
+
+#include "memory.h"
+#include "options.h"
+#include "profile.h"
+
+enum {
+    OPTION_TRACEBINARY = 256,
+    OPTION_DECODETRACE,
+    OPTION_FLIGHTRECORDER,
+    OPTION_CONFIG,
+    OPTION_RAMORIGIN,
+    OPTION_RAMLENGTH,
+    OPTION_ROMORIGIN,
+    OPTION_ROMLENGTH,
+    OPTION_UARTOUTPUT,
+    OPTION_UARTINPUT,
+    OPTION_MMAP,
+    OPTION_STATS,
+    OPTION_MAXINSTRUCTIONS,
+    OPTION_ELF,
+    OPTION_SYMBOLS,
+    OPTION_PROFILE,
+    OPTION_PROFILELISTING,
+    OPTION_CALLGRAPH,
+    OPTION_CHECKPOINT,
+    OPTION_CHECKPOINTAT,
+    OPTION_CHECKPOINTPC,
+    OPTION_RESTORE,
+    OPTION_LOCKSTEP,
+    OPTION_RECORD,
+    OPTION_STEPBACK,
+    OPTION_LASTWRITE,
+    OPTION_RAMAFTER,
+    OPTION_APPLYDELTA,
+    OPTION_BATCHLIST,
+    OPTION_JOBS,
+    OPTION_HELP,
+};
+
+static const struct option longoptions[] = {
+    {"trace-binary", required_argument, NULL, OPTION_TRACEBINARY},
+    {"decode-trace", required_argument, NULL, OPTION_DECODETRACE},
+    {"flight-recorder", required_argument, NULL, OPTION_FLIGHTRECORDER},
+    {"config", required_argument, NULL, OPTION_CONFIG},
+    {"ram-origin", required_argument, NULL, OPTION_RAMORIGIN},
+    {"ram-length", required_argument, NULL, OPTION_RAMLENGTH},
+    {"rom-origin", required_argument, NULL, OPTION_ROMORIGIN},
+    {"rom-length", required_argument, NULL, OPTION_ROMLENGTH},
+    {"uart-output", required_argument, NULL, OPTION_UARTOUTPUT},
+    {"uart-input", required_argument, NULL, OPTION_UARTINPUT},
+    {"mmap", no_argument, NULL, OPTION_MMAP},
+    {"stats", no_argument, NULL, OPTION_STATS},
+    {"max-instructions", required_argument, NULL, OPTION_MAXINSTRUCTIONS},
+    {"elf", required_argument, NULL, OPTION_ELF},
+    {"symbols", required_argument, NULL, OPTION_SYMBOLS},
+    {"profile", required_argument, NULL, OPTION_PROFILE},
+    {"profile-listing", required_argument, NULL, OPTION_PROFILELISTING},
+    {"callgraph", required_argument, NULL, OPTION_CALLGRAPH},
+    {"checkpoint", required_argument, NULL, OPTION_CHECKPOINT},
+    {"checkpoint-at", required_argument, NULL, OPTION_CHECKPOINTAT},
+    {"checkpoint-pc", required_argument, NULL, OPTION_CHECKPOINTPC},
+    {"restore", required_argument, NULL, OPTION_RESTORE},
+    {"lockstep", required_argument, NULL, OPTION_LOCKSTEP},
+    {"record", required_argument, NULL, OPTION_RECORD},
+    {"step-back", required_argument, NULL, OPTION_STEPBACK},
+    {"last-write", required_argument, NULL, OPTION_LASTWRITE},
+    {"ram-after", required_argument, NULL, OPTION_RAMAFTER},
+    {"apply-delta", no_argument, NULL, OPTION_APPLYDELTA},
+    {"batch-list", required_argument, NULL, OPTION_BATCHLIST},
+    {"jobs", required_argument, NULL, OPTION_JOBS},
+    {"help", no_argument, NULL, OPTION_HELP},
+    {NULL, 0, NULL, 0},
+};
+
+static void printUsage(const char *program) {
+    printf("Usage: %s [options] [directory...]\n", program);
+    printf("Runs dut-rom.bin and dut-ram.bin from the current directory, or from every\n");
+    printf("given test directory in parallel. Messages of a test directory go to its rve.log.\n");
+    printf("\n");
+    printf("  --trace-binary FILE  Write the hook trace in binary form to FILE.\n");
+    printf("  --decode-trace FILE  Print binary trace FILE as text and exit. With --symbols or --elf the\n");
+    printf("                       addresses get the symbols of that ELF file, like in the live trace.\n");
+    printf("  --flight-recorder N  Keep the last N hook events in memory and print them\n");
+    printf("                       only when the emulation stops abnormally.\n");
+    printf("  --config FILE        Read options from FILE, lines like ram-length = 64M. Options after\n");
+    printf("                       --config override it.\n");
+    printf("  --ram-origin ADDRESS Guest address of RAM, default 0x%08X.\n", RAM_ORIGIN);
+    printf("  --ram-length SIZE    Size of RAM, default 0x%08X. K, M and G suffixes are allowed.\n", RAM_LENGTH);
+    printf("  --rom-origin ADDRESS Guest address of ROM, default 0x%08X.\n", ROM_ORIGIN);
+    printf("  --rom-length SIZE    Size of ROM, default 0x%08X.\n", RAM_LENGTH);
+    printf("  --uart-output FILE   Write what the guest sends to the UART at 0x%08X to FILE\n", IO_ORIGIN);
+    printf("                       instead of the log.\n");
+    printf("  --uart-input FILE    Let the guest receive FILE through the UART.\n");
+    printf("  --mmap               Map the images copy-on-write instead of reading them.\n");
+    printf("  --stats              Count loads from and stores to ROM and print the counts.\n");
+    printf("  --elf FILE           Load the test from ELF FILE, with the signature between the symbols\n");
+    printf("                       begin_signature and end_signature, instead of the .bin and .txt files.\n");
+    printf("  --symbols FILE       Print guest addresses as symbol+offset with the symbols of ELF FILE.\n");
+    printf("                       --elf does this with the symbols of the test.\n");
+    printf("  --max-instructions N Stop a test after N instructions, K, M and G suffixes are allowed. The\n");
+    printf("                       default is RVE_MAX_INSTRUCTIONS from the environment, or else five\n");
+    printf("                       times the number of words in dut-rom.bin.\n");
+    printf("  --profile FILE       Count executions per address and, with hooks, per instruction name\n");
+    printf("                       instead of printing the trace. FILE ending in .json gets JSON, else CSV.\n");
+    printf("  --profile-listing FILE\n");
+    printf("                       Also write the disassembly of dut-rom.bin with the counts to FILE,\n");
+    printf("                       made by %s or RVE_OBJDUMP.\n", PROFILE_OBJDUMP);
+    printf("  --callgraph FILE     Follow calls and returns and write the instructions per function and\n");
+    printf("                       per call to FILE in callgrind format.\n");
+    printf("  --checkpoint FILE    Write the hart, the timer and the changed pages of RAM and ROM to FILE\n");
+    printf("                       at --checkpoint-at N instructions or at --checkpoint-pc ADDRESS.\n");
+    printf("  --restore FILE       Continue the test from checkpoint FILE instead of from the start.\n");
+    printf("  --lockstep FILE      Compare the pc, register write and store of every instruction with the\n");
+    printf("                       Spike --log-commits or Sail log FILE, - for standard input, and stop\n");
+    printf("                       at the first difference. Needs hooks.\n");
+    printf("  --record N           Keep a snapshot of the registers and the changed RAM pages every N\n");
+    printf("                       instructions, for --step-back and --last-write.\n");
+    printf("  --step-back K        After the run, print the registers K instructions before the end.\n");
+    printf("  --last-write ADDRESS After the run, print the last store to the byte at ADDRESS.\n");
+    printf("  --ram-after MODE     Write dut-ram-after.bin in full (default), only the changed pages\n");
+    printf("                       to dut-ram-after.delta (delta) or the changed pages over a copy\n");
+    printf("                       of dut-ram.bin (dirty).\n");
+    printf("  --apply-delta        Rebuild dut-ram-after.bin from dut-ram-after.delta and exit.\n");
+    printf("  --batch-list FILE    Also run the test directories listed in FILE, one per line.\n");
+    printf("  --jobs N             Emulate N tests at the same time, default all processors.\n");
+    printf("  --help               Show this help.\n");
+}
+
+/**
+ * Parses a number with an optional K, M or G suffix. Returns 0 on success.
+ */
+static int parseSize(const char *text, uint64_t *value) {
+    char *end;
+    *value = strtoull(text, &end, 0);
+    if (end == text) {
+        return 1;
+    }
+
+    switch (*end) {
+        case 'K':
+        case 'k': {
+            *value <<= 10;
+            end++;
+            break;
+        }
+        case 'M':
+        case 'm': {
+            *value <<= 20;
+            end++;
+            break;
+        }
+        case 'G':
+        case 'g': {
+            *value <<= 30;
+            end++;
+            break;
+        }
+    }
+
+    return *end != '\0';
+}
+
+/**
+ * Sets the instruction budget. Returns 0 on success.
+ */
+static int setMaxInstructions(Options_t *options, const char *text) {
+    uint64_t value;
+    if (parseSize(text, &value) != 0 ||
+        value == 0 ||
+        value > SIZE_MAX) {
+        printf("The instruction budget needs a positive number, not %s.\n", text);
+        return 1;
+    }
+    options->maxinstructions = value;
+    return 0;
+}
+
+/**
+ * Sets a part of the memory layout by its option name. Returns 0 on success.
+ */
+static int setLayout(MemoryLayout_t *layout, const char *name, const char *text) {
+    uint64_t value;
+    if (parseSize(text, &value) != 0 ||
+        value > UINT32_MAX) {
+        printf("--%s needs a 32-bit number, not %s.\n", name, text);
+        return 1;
+    }
+
+    if (strcmp(name, "ram-origin") == 0) {
+        layout->ramorigin = value;
+    } else if (strcmp(name, "ram-length") == 0) {
+        layout->ramlength = value;
+    } else if (strcmp(name, "rom-origin") == 0) {
+        layout->romorigin = value;
+    } else if (strcmp(name, "rom-length") == 0) {
+        layout->romlength = value;
+    } else {
+        printf("Unknown option %s.\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Reads a file with a name = value option per line. Returns 0 on success.
+ */
+static int readConfig(const char *path, Options_t *options) {
+    FILE *config = fopen(path, "r");
+    if (config == NULL) {
+        printf("Cannot open %s.\n", path);
+        return 1;
+    }
+
+    char line[256];
+    unsigned linenumber = 0;
+    while (fgets(line, sizeof(line), config) != NULL) {
+        linenumber++;
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        char name[64];
+        char value[64];
+        int fields = sscanf(line, " %63[^= \t] = %63s", name, value);
+        if (fields == EOF ||
+            fields == 0) {
+            continue;
+        }
+        if (fields != 2 ||
+            setLayout(&options->layout, name, value) != 0) {
+            printf("%s:%u: expected name = value.\n", path, linenumber);
+            fclose(config);
+            return 1;
+        }
+    }
+
+    fclose(config);
+    return 0;
+}
+
+/**
+ * Checks that RAM and ROM are whole pages inside the guest address space and do not overlap. Returns 0 when they are.
+ */
+static int checkLayout(const MemoryLayout_t *layout) {
+    uint64_t ramend = (uint64_t)layout->ramorigin + layout->ramlength;
+    uint64_t romend = (uint64_t)layout->romorigin + layout->romlength;
+
+    if ((layout->ramorigin | layout->ramlength | layout->romorigin | layout->romlength) % RAM_PAGE_LENGTH != 0) {
+        printf("Origins and lengths of RAM and ROM must be multiples of 0x%X.\n", RAM_PAGE_LENGTH);
+        return 1;
+    }
+    if (layout->ramlength == 0 ||
+        layout->romlength == 0) {
+        printf("RAM and ROM cannot be empty.\n");
+        return 1;
+    }
+    if (ramend > (UINT64_C(1) << 32) ||
+        romend > (UINT64_C(1) << 32)) {
+        printf("RAM and ROM must end inside the 32-bit address space.\n");
+        return 1;
+    }
+    if (layout->ramorigin < romend &&
+        layout->romorigin < ramend) {
+        printf("RAM and ROM overlap.\n");
+        return 1;
+    }
+    return 0;
+}
+
+int OptionsParse(int argc, char *argv[], Options_t *options) {
+    memset(options, 0, sizeof(Options_t));
+    options->layout.ramorigin = RAM_ORIGIN;
+    options->layout.ramlength = RAM_LENGTH;
+    options->layout.romorigin = ROM_ORIGIN;
+    options->layout.romlength = RAM_LENGTH;
+
+    // The command line overrides the environment.
+    const char *maxinstructions = getenv("RVE_MAX_INSTRUCTIONS");
+    if (maxinstructions != NULL &&
+        setMaxInstructions(options, maxinstructions) != 0) {
+        return 1;
+    }
+
+    int option;
+    int index;
+    while ((option = getopt_long(argc, argv, "", longoptions, &index)) != -1) {
+        switch (option) {
+            case OPTION_TRACEBINARY: {
+                options->tracebinary = optarg;
+                break;
+            }
+            case OPTION_DECODETRACE: {
+                options->decodetrace = optarg;
+                break;
+            }
+            case OPTION_FLIGHTRECORDER: {
+                char *end;
+                options->flightrecorder = strtoul(optarg, &end, 0);
+                if (*end != '\0' ||
+                    options->flightrecorder == 0) {
+                    printf("--flight-recorder needs a positive number of events.\n");
+                    return 1;
+                }
+                break;
+            }
+            case OPTION_CONFIG: {
+                if (readConfig(optarg, options) != 0) {
+                    return 1;
+                }
+                break;
+            }
+            case OPTION_RAMORIGIN:
+            case OPTION_RAMLENGTH:
+            case OPTION_ROMORIGIN:
+            case OPTION_ROMLENGTH: {
+                if (setLayout(&options->layout, longoptions[index].name, optarg) != 0) {
+                    return 1;
+                }
+                break;
+            }
+            case OPTION_UARTOUTPUT: {
+                options->uartoutput = optarg;
+                break;
+            }
+            case OPTION_UARTINPUT: {
+                options->uartinput = optarg;
+                break;
+            }
+            case OPTION_MMAP: {
+                options->mmap = 1;
+                break;
+            }
+            case OPTION_STATS: {
+                options->stats = 1;
+                break;
+            }
+            case OPTION_MAXINSTRUCTIONS: {
+                if (setMaxInstructions(options, optarg) != 0) {
+                    return 1;
+                }
+                break;
+            }
+            case OPTION_ELF: {
+                options->elf = optarg;
+                break;
+            }
+            case OPTION_SYMBOLS: {
+                options->symbols = optarg;
+                break;
+            }
+            case OPTION_PROFILE: {
+                options->profile = optarg;
+                break;
+            }
+            case OPTION_PROFILELISTING: {
+                options->profilelisting = optarg;
+                break;
+            }
+            case OPTION_CALLGRAPH: {
+                options->callgraph = optarg;
+                break;
+            }
+            case OPTION_CHECKPOINT: {
+                options->checkpoint = optarg;
+                break;
+            }
+            case OPTION_CHECKPOINTAT: {
+                uint64_t value;
+                if (parseSize(optarg, &value) != 0 ||
+                    value > SIZE_MAX) {
+                    printf("--checkpoint-at needs a number of instructions, not %s.\n", optarg);
+                    return 1;
+                }
+                options->checkpointat = value;
+                options->checkpointatpc = 0;
+                break;
+            }
+            case OPTION_CHECKPOINTPC: {
+                uint64_t value;
+                if (parseSize(optarg, &value) != 0 ||
+                    value > UINT32_MAX) {
+                    printf("--checkpoint-pc needs a 32-bit address, not %s.\n", optarg);
+                    return 1;
+                }
+                options->checkpointpc = value;
+                options->checkpointatpc = 1;
+                break;
+            }
+            case OPTION_RESTORE: {
+                options->restore = optarg;
+                break;
+            }
+            case OPTION_LOCKSTEP: {
+                options->lockstep = optarg;
+                break;
+            }
+            case OPTION_RECORD:
+            case OPTION_STEPBACK: {
+                uint64_t value;
+                if (parseSize(optarg, &value) != 0 ||
+                    value == 0 ||
+                    value > SIZE_MAX) {
+                    printf("--%s needs a positive number of instructions, not %s.\n", longoptions[index].name, optarg);
+                    return 1;
+                }
+                if (option == OPTION_RECORD) {
+                    options->record = value;
+                } else {
+                    options->stepback = value;
+                }
+                break;
+            }
+            case OPTION_LASTWRITE: {
+                uint64_t value;
+                if (parseSize(optarg, &value) != 0 ||
+                    value > UINT32_MAX) {
+                    printf("--last-write needs a 32-bit address, not %s.\n", optarg);
+                    return 1;
+                }
+                options->lastwrite = value;
+                options->findlastwrite = 1;
+                break;
+            }
+            case OPTION_RAMAFTER: {
+                if (strcmp(optarg, "full") == 0) {
+                    options->ramafter = RAMAFTER_FULL;
+                } else if (strcmp(optarg, "delta") == 0) {
+                    options->ramafter = RAMAFTER_DELTA;
+                } else if (strcmp(optarg, "dirty") == 0) {
+                    options->ramafter = RAMAFTER_DIRTY;
+                } else {
+                    printf("--ram-after needs full, delta or dirty.\n");
+                    return 1;
+                }
+                break;
+            }
+            case OPTION_APPLYDELTA: {
+                options->applydelta = 1;
+                break;
+            }
+            case OPTION_BATCHLIST: {
+                options->batchlist = optarg;
+                break;
+            }
+            case OPTION_JOBS: {
+                char *end;
+                options->jobs = strtoul(optarg, &end, 0);
+                if (*end != '\0' ||
+                    options->jobs == 0) {
+                    printf("--jobs needs a positive number of tests.\n");
+                    return 1;
+                }
+                break;
+            }
+            case OPTION_HELP: {
+                printUsage(argv[0]);
+                return OPTIONS_HELP;
+            }
+            default: {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+    }
+
+    // Without dut-ram.bin there is nothing to copy the dirty pages over or to apply a delta to.
+    if (options->elf != NULL &&
+        (options->ramafter == RAMAFTER_DIRTY || options->ramafter == RAMAFTER_DELTA)) {
+        printf("--ram-after %s needs dut-ram.bin, it does not work with --elf.\n",
+               options->ramafter == RAMAFTER_DIRTY ? "dirty" : "delta");
+        return 1;
+    }
+
+    // Both take the hook events, a trace would never be written.
+    if (options->tracebinary != NULL &&
+        options->flightrecorder != 0) {
+        printf("--trace-binary and --flight-recorder do not work together.\n");
+        return 1;
+    }
+
+    // The listing needs the counts.
+    if (options->profilelisting != NULL &&
+        options->profile == NULL) {
+        printf("--profile-listing needs --profile.\n");
+        return 1;
+    }
+
+    // A checkpoint needs a moment to be taken at.
+    if (options->checkpoint != NULL &&
+        options->checkpointat == 0 &&
+        !options->checkpointatpc) {
+        printf("--checkpoint needs --checkpoint-at or --checkpoint-pc.\n");
+        return 1;
+    }
+
+    // The questions are answered from the snapshots.
+    if ((options->stepback != 0 || options->findlastwrite) &&
+        options->record == 0) {
+        printf("--step-back and --last-write need --record.\n");
+        return 1;
+    }
+
+    options->directories = &argv[optind];
+    options->directorycount = argc - optind;
+
+    // Standard input can only be read by one test.
+    if (options->lockstep != NULL &&
+        strcmp(options->lockstep, "-") == 0 &&
+        (options->directorycount > 1 || options->batchlist != NULL)) {
+        printf("--lockstep - only works with a single test.\n");
+        return 1;
+    }
+
+    return checkLayout(&options->layout);
+}
@@ -0,0 +1,225 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hook.h"
+#include "image.h"
+#include "profile.h"
+
+int ProfileInit(Profile_t *profile, const MemoryLayout_t *layout) {
+    memset(profile, 0, sizeof(Profile_t));
+    profile->origin[0] = layout->romorigin;
+    profile->length[0] = layout->romlength;
+    profile->origin[1] = layout->ramorigin;
+    profile->length[1] = layout->ramlength;
+
+    for (uint8_t area = 0; area < 2; area++) {
+        profile->counts[area] = (uint64_t *)ImageAllocate(profile->length[area] / 2 * sizeof(uint64_t));
+        if (profile->counts[area] == NULL) {
+            ProfileFree(profile);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void ProfileFree(Profile_t *profile) {
+    for (uint8_t area = 0; area < 2; area++) {
+        if (profile->counts[area] != NULL) {
+            ImageFree((uint8_t *)profile->counts[area], profile->length[area] / 2 * sizeof(uint64_t));
+            profile->counts[area] = NULL;
+        }
+    }
+}
+
+/**
+ * Returns the count of an address, 0 outside ROM and RAM.
+ */
+static uint64_t countOf(const Profile_t *profile, uint32_t address) {
+    for (uint8_t area = 0; area < 2; area++) {
+        uint32_t offset = address - profile->origin[area];
+        if (offset < profile->length[area]) {
+            return profile->counts[area][offset >> 1];
+        }
+    }
+    return 0;
+}
+
+typedef struct {
+    FILE *out;
+    uint8_t json;
+    uint8_t first;
+} ProfileWriter_t;
+
+static void writeMnemonic(const char *name, uint64_t count, void *argument) {
+    ProfileWriter_t *writer = argument;
+
+    if (writer->json) {
+        fprintf(writer->out, "%s\n    {\"mnemonic\": \"%s\", \"count\": %llu}",
+                writer->first ? "" : ",",
+                name,
+                (unsigned long long)count);
+    } else {
+        fprintf(writer->out, "mnemonic,%s,%llu,\n", name, (unsigned long long)count);
+    }
+    writer->first = 0;
+}
+
+int ProfileWrite(const Profile_t *profile, const char *path, SymbolTable_t *symbols) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        return 1;
+    }
+
+    size_t pathlength = strlen(path);
+    ProfileWriter_t writer = {
+        .out = out,
+        .json = pathlength >= 5 && strcmp(&path[pathlength - 5], ".json") == 0,
+        .first = 1,
+    };
+
+    if (writer.json) {
+        fprintf(out, "{\n  \"outside\": %llu,\n  \"pc\": [", (unsigned long long)profile->outside);
+    } else {
+        fprintf(out, "kind,key,count,symbol\n");
+    }
+
+    for (uint8_t area = 0; area < 2; area++) {
+        for (uint32_t index = 0; index < profile->length[area] / 2; index++) {
+            uint64_t count = profile->counts[area][index];
+            if (count == 0) {
+                continue;
+            }
+
+            uint32_t address = profile->origin[area] + index * 2;
+            char symbol[256];
+            SymbolsFormat(symbols, address, symbol, sizeof(symbol));
+            if (writer.json) {
+                fprintf(out, "%s\n    {\"pc\": \"0x%08X\", \"symbol\": \"%s\", \"count\": %llu}",
+                        writer.first ? "" : ",",
+                        address,
+                        symbol,
+                        (unsigned long long)count);
+            } else {
+                fprintf(out, "pc,0x%08X,%llu,%s\n", address, (unsigned long long)count, symbol);
+            }
+            writer.first = 0;
+        }
+    }
+
+    if (writer.json) {
+        fprintf(out, "\n  ],\n  \"mnemonics\": [");
+    }
+    writer.first = 1;
+    HookForEachProfiled(writeMnemonic, &writer);
+    if (writer.json) {
+        fprintf(out, "\n  ]\n}\n");
+    }
+
+    return fclose(out) != 0;
+}
+
+/**
+ * Starts a program with its standard output to a pipe, without a shell. Returns the read end or NULL.
+ */
+static FILE *startProgram(char *const argv[], pid_t *pid) {
+    // Tests of a batch start programs at the same time, no other child may inherit the pipe.
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        return NULL;
+    }
+
+    *pid = fork();
+    if (*pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    close(fds[1]);
+    if (*pid < 0) {
+        close(fds[0]);
+        return NULL;
+    }
+
+    FILE *output = fdopen(fds[0], "r");
+    if (output == NULL) {
+        close(fds[0]);
+        waitpid(*pid, NULL, 0);
+    }
+    return output;
+}
+
+/**
+ * Closes the pipe of startProgram and waits for the program. Returns 0 when it succeeded.
+ */
+static int finishProgram(FILE *output, pid_t pid) {
+    fclose(output);
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        // Only an interrupted wait is tried again.
+        if (errno != EINTR) {
+            return 1;
+        }
+    }
+    return !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+}
+
+int ProfileWriteListing(const Profile_t *profile, const char *path, const char *rompath, uint8_t elf, FILE *log) {
+    const char *objdump = getenv("RVE_OBJDUMP");
+    if (objdump == NULL) {
+        objdump = PROFILE_OBJDUMP;
+    }
+
+    // An ELF file knows its addresses, a ROM image starts at the origin of ROM. The arguments go to objdump as
+    // they are, a path needs no quoting.
+    char vma[32];
+    snprintf(vma, sizeof(vma), "--adjust-vma=0x%08X", profile->origin[0]);
+    char *const elfargv[] = {(char *)objdump, "-d", (char *)rompath, NULL};
+    char *const binaryargv[] = {(char *)objdump, "-D", "-b", "binary", "-m", "riscv:rv32", vma, (char *)rompath, NULL};
+
+    pid_t pid;
+    FILE *disassembly = startProgram(elf ? elfargv : binaryargv, &pid);
+    if (disassembly == NULL) {
+        fprintf(log, "Cannot run %s.\n", objdump);
+        return 1;
+    }
+
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        finishProgram(disassembly, pid);
+        return 1;
+    }
+
+    // Instruction lines of objdump start with the address, like "20000000:\t00500293\tli\tt0,5".
+    char line[1024];
+    while (fgets(line, sizeof(line), disassembly) != NULL) {
+        char *end;
+        unsigned long address = strtoul(line, &end, 16);
+        if (end != line &&
+            *end == ':') {
+            fprintf(out, "%12llu %s", (unsigned long long)countOf(profile, address), line);
+        } else {
+            fprintf(out, "%12s %s", "", line);
+        }
+    }
+
+    int failed = fclose(out) != 0;
+    if (finishProgram(disassembly, pid) != 0) {
+        fprintf(log, "%s could not disassemble %s.\n", objdump, rompath);
+        failed = 1;
+    }
+    return failed;
+}
@@ -0,0 +1,44 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include "image.h"
+#include "region.h"
+
+RegionTable_t *RegionAllocate(void) {
+    // Only the entries of mapped pages are ever touched, the rest of the table stays unbacked.
+    return (RegionTable_t *)ImageAllocate(sizeof(RegionTable_t));
+}
+
+void RegionFree(RegionTable_t *table) {
+    ImageFree((uint8_t *)table, sizeof(RegionTable_t));
+}
+
+static void setEntries(RegionTable_t *table, uint32_t address, uintptr_t host, uint32_t length, uint8_t access) {
+    uint32_t first = address >> REGION_PAGE_SHIFT;
+    uint32_t pages = length >> REGION_PAGE_SHIFT;
+
+    for (uint32_t i = 0; i < pages && first + i < REGION_PAGES; i++) {
+        uintptr_t entry = 0;
+        if (host != 0) {
+            entry = host - address;
+        }
+        if (access & REGION_LOAD) {
+            table->load[first + i] = entry;
+        }
+        if (access & REGION_STORE) {
+            table->store[first + i] = entry;
+        }
+    }
+}
+
+void RegionMap(RegionTable_t *table, uint32_t address, uint8_t *host, uint32_t length, uint8_t access) {
+    setEntries(table, address, (uintptr_t)host, length, access);
+}
+
+void RegionUnmap(RegionTable_t *table, uint32_t address, uint32_t length, uint8_t access) {
+    setEntries(table, address, 0, length, access);
+}
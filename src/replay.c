@@ -0,0 +1,430 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "instance.h"
+#include "memory.h"
+#include "replay.h"
+#include "run.h"
+
+// Memory of a page that was never loaded.
+static const uint8_t zeropage[RAM_PAGE_LENGTH];
+
+static inline size_t ramPages(void) {
+    return instance->layout.ramlength >> REGION_PAGE_SHIFT;
+}
+
+/**
+ * Pages of the record, those of RAM followed by those of ROM.
+ */
+static inline size_t recordPages(void) {
+    return (instance->layout.ramlength + instance->layout.romlength) >> REGION_PAGE_SHIFT;
+}
+
+/**
+ * Returns the page of the record that holds a guest address, SIZE_MAX outside RAM and ROM.
+ */
+static size_t pageIndex(uint32_t address) {
+    const MemoryLayout_t *layout = &instance->layout;
+    if (address - layout->ramorigin < layout->ramlength) {
+        return (address - layout->ramorigin) >> REGION_PAGE_SHIFT;
+    }
+    if (address - layout->romorigin < layout->romlength) {
+        return ramPages() + ((address - layout->romorigin) >> REGION_PAGE_SHIFT);
+    }
+    return SIZE_MAX;
+}
+
+static inline uint8_t *hostPage(size_t index) {
+    size_t rampages = ramPages();
+    if (index < rampages) {
+        return &instance->memory[index * RAM_PAGE_LENGTH];
+    }
+    return &instance->firmware[(index - rampages) * RAM_PAGE_LENGTH];
+}
+
+static inline uint8_t isDirty(size_t index) {
+    size_t rampages = ramPages();
+    size_t page = index < rampages ? (instance->layout.ramorigin >> REGION_PAGE_SHIFT) + index
+                                   : (instance->layout.romorigin >> REGION_PAGE_SHIFT) + index - rampages;
+    return (instance->dirty[page / 64] & (UINT64_C(1) << (page % 64))) != 0;
+}
+
+/**
+ * Returns the content of a page as it was loaded.
+ */
+static const uint8_t *basePage(const Replay_t *replay, size_t index) {
+    size_t rampages = ramPages();
+    if (index < rampages) {
+        size_t offset = index * RAM_PAGE_LENGTH;
+        return offset < replay->basesize ? &replay->base[offset] : zeropage;
+    }
+    size_t offset = (index - rampages) * RAM_PAGE_LENGTH;
+    return offset < replay->rombasesize ? &replay->rombase[offset] : zeropage;
+}
+
+/**
+ * Returns the content of a page at the last snapshot that saved or could have saved it.
+ */
+static const uint8_t *savedPage(const Replay_t *replay, size_t index) {
+    if (replay->latest[index] != REPLAY_BASE) {
+        return &replay->pagedata[(size_t)replay->latest[index] * RAM_PAGE_LENGTH];
+    }
+    return basePage(replay, index);
+}
+
+/**
+ * Copies the loaded part of RAM or ROM. Returns 0 on success.
+ */
+static int copyBase(uint8_t **base, size_t *basesize, const uint8_t *memory, size_t loadedsize, size_t length) {
+    *basesize = (loadedsize + RAM_PAGE_LENGTH - 1) & ~(size_t)(RAM_PAGE_LENGTH - 1);
+    if (*basesize > length) {
+        *basesize = length;
+    }
+    if (*basesize == 0) {
+        *base = NULL;
+        return 0;
+    }
+    *base = ImageAllocate(*basesize);
+    if (*base == NULL) {
+        return 1;
+    }
+    memcpy(*base, memory, *basesize);
+    return 0;
+}
+
+int ReplayInit(Replay_t *replay, size_t interval, size_t ramloadedsize, size_t romloadedsize) {
+    memset(replay, 0, sizeof(Replay_t));
+    size_t pages = recordPages();
+
+    replay->latest = malloc(pages * sizeof(uint32_t));
+    replay->firstdirty = malloc(pages * sizeof(uint32_t));
+    replay->restored = calloc(pages, sizeof(uint8_t));
+    if (replay->latest == NULL ||
+        replay->firstdirty == NULL ||
+        replay->restored == NULL ||
+        copyBase(&replay->base, &replay->basesize, instance->memory, ramloadedsize, instance->layout.ramlength) != 0 ||
+        copyBase(&replay->rombase, &replay->rombasesize, instance->firmware, romloadedsize, instance->layout.romlength) != 0) {
+        ReplayFree(replay);
+        return 1;
+    }
+
+    for (size_t i = 0; i < pages; i++) {
+        replay->latest[i] = REPLAY_BASE;
+        replay->firstdirty[i] = UINT32_MAX;
+    }
+    replay->interval = interval;
+    return 0;
+}
+
+void ReplayFree(Replay_t *replay) {
+    free(replay->snapshots);
+    free(replay->pagenumbers);
+    free(replay->pagedata);
+    free(replay->latest);
+    free(replay->firstdirty);
+    free(replay->restored);
+    if (replay->base != NULL) {
+        ImageFree(replay->base, replay->basesize);
+    }
+    if (replay->rombase != NULL) {
+        ImageFree(replay->rombase, replay->rombasesize);
+    }
+    memset(replay, 0, sizeof(Replay_t));
+}
+
+/**
+ * Keeps the current content of a page as its latest version. Returns 0 on success.
+ */
+static int savePage(Replay_t *replay, size_t index) {
+    if (replay->pagecount == replay->pagecapacity) {
+        size_t capacity = replay->pagecapacity != 0 ? replay->pagecapacity * 2 : 64;
+        uint32_t *pagenumbers = realloc(replay->pagenumbers, capacity * sizeof(uint32_t));
+        if (pagenumbers == NULL) {
+            return 1;
+        }
+        replay->pagenumbers = pagenumbers;
+        uint8_t *pagedata = realloc(replay->pagedata, capacity * RAM_PAGE_LENGTH);
+        if (pagedata == NULL) {
+            return 1;
+        }
+        replay->pagedata = pagedata;
+        replay->pagecapacity = capacity;
+    }
+
+    memcpy(&replay->pagedata[replay->pagecount * RAM_PAGE_LENGTH], hostPage(index), RAM_PAGE_LENGTH);
+    replay->pagenumbers[replay->pagecount] = index;
+    replay->latest[index] = replay->pagecount;
+    replay->pagecount++;
+    return 0;
+}
+
+int ReplaySnapshot(Replay_t *replay) {
+    if (replay->snapshotcount == replay->snapshotcapacity) {
+        size_t capacity = replay->snapshotcapacity != 0 ? replay->snapshotcapacity * 2 : 64;
+        ReplaySnapshot_t *snapshots = realloc(replay->snapshots, capacity * sizeof(ReplaySnapshot_t));
+        if (snapshots == NULL) {
+            return 1;
+        }
+        replay->snapshots = snapshots;
+        replay->snapshotcapacity = capacity;
+    }
+
+    ReplaySnapshot_t *snapshot = &replay->snapshots[replay->snapshotcount];
+    snapshot->loopcounter = instance->loopcounter;
+    snapshot->state = instance->state;
+    snapshot->clint = instance->clint;
+    snapshot->hang = instance->hang;
+    snapshot->busaccesses = instance->bus.accesses;
+    snapshot->stores = instance->stores;
+    snapshot->nextevent = instance->nextevent;
+    UartSave(&instance->uart, &snapshot->uart);
+    snapshot->firstpage = replay->pagecount;
+
+    // Only pages that were stored to can differ from their last version, and many stores leave a page as it was.
+    size_t pages = recordPages();
+    for (size_t i = 0; i < pages; i++) {
+        if (!isDirty(i)) {
+            continue;
+        }
+        if (replay->firstdirty[i] == UINT32_MAX) {
+            replay->firstdirty[i] = replay->snapshotcount;
+        }
+        if (memcmp(hostPage(i), savedPage(replay, i), RAM_PAGE_LENGTH) != 0 &&
+            savePage(replay, i) != 0) {
+            replay->pagecount = snapshot->firstpage;
+            return 1;
+        }
+    }
+
+    snapshot->pagecount = replay->pagecount - snapshot->firstpage;
+    replay->snapshotcount++;
+    return 0;
+}
+
+/**
+ * Puts RAM, ROM, the hart and the devices back as they were at a snapshot. Returns 0 on success, 1 when the UART
+ * input cannot be moved back.
+ */
+static int restoreSnapshot(Replay_t *replay, size_t index) {
+    size_t pages = recordPages();
+    memset(replay->restored, 0, pages);
+
+    // The newest version of a page at or before the snapshot wins.
+    for (size_t s = index + 1; s-- > 0;) {
+        const ReplaySnapshot_t *snapshot = &replay->snapshots[s];
+        for (size_t j = snapshot->firstpage; j < snapshot->firstpage + snapshot->pagecount; j++) {
+            uint32_t page = replay->pagenumbers[j];
+            if (!replay->restored[page]) {
+                memcpy(hostPage(page), &replay->pagedata[j * RAM_PAGE_LENGTH], RAM_PAGE_LENGTH);
+                replay->restored[page] = 1;
+            }
+        }
+    }
+
+    // Every other page that was stored to was still as loaded.
+    for (size_t i = 0; i < pages; i++) {
+        if (isDirty(i) &&
+            !replay->restored[i]) {
+            memcpy(hostPage(i), basePage(replay, i), RAM_PAGE_LENGTH);
+        }
+    }
+
+    const ReplaySnapshot_t *snapshot = &replay->snapshots[index];
+    instance->loopcounter = snapshot->loopcounter;
+    instance->state = snapshot->state;
+    instance->clint = snapshot->clint;
+    instance->hang = snapshot->hang;
+    instance->bus.accesses = snapshot->busaccesses;
+    instance->stores = snapshot->stores;
+    instance->nextevent = snapshot->nextevent;
+    instance->pleasestop = STOP_NONE;
+    return UartRestore(&instance->uart, &snapshot->uart);
+}
+
+/**
+ * Returns the last snapshot at or before an instruction count.
+ */
+static size_t findSnapshot(const Replay_t *replay, size_t loopcounter) {
+    size_t index = replay->snapshotcount - 1;
+    while (index > 0 &&
+           replay->snapshots[index].loopcounter > loopcounter) {
+        index--;
+    }
+    return index;
+}
+
+/**
+ * Executes the instructions up to an instruction count once more.
+ */
+static void runTo(size_t loopcounter) {
+    while (instance->loopcounter < loopcounter) {
+        uint8_t stop = RunInstructions(loopcounter - instance->loopcounter);
+        // The run went on after a hang check it did not do at the same moment.
+        if (stop == STOP_HANG) {
+            instance->pleasestop = STOP_NONE;
+        } else if (stop != STOP_NONE) {
+            return;
+        }
+    }
+}
+
+/**
+ * Finds the store an instruction did. Returns 1 and fills store when it is one.
+ */
+static uint8_t storeOf(const RiscvEmulatorState_t *state, uint32_t programcounter, ReplayStore_t *store) {
+    uint32_t instruction = state->instruction.value;
+    const uint32_t *x = state->reg.x;
+    uint8_t instructionlength;
+
+    if ((instruction & 3) == 3) {
+        uint8_t funct3 = (instruction >> 12) & 7;
+        if ((instruction & 0x7F) != 0x23 ||
+            funct3 > 2) {
+            return 0;
+        }
+        // sb, sh and sw.
+        uint32_t offset = ((instruction >> 20) & 0xFE0) | ((instruction >> 7) & 31);
+        if (offset & 0x800) {
+            offset |= 0xFFFFF000;
+        }
+        store->address = x[(instruction >> 15) & 31] + offset;
+        store->value = x[(instruction >> 20) & 31];
+        store->length = 1 << funct3;
+        instructionlength = 4;
+    } else {
+        uint16_t compressed = instruction & 0xFFFF;
+        if ((compressed & 0xE003) == 0xC000) {
+            // c.sw
+            uint32_t offset = ((compressed >> 7) & 0x38) | ((compressed >> 4) & 4) | ((compressed << 1) & 0x40);
+            store->address = x[8 + ((compressed >> 7) & 7)] + offset;
+            store->value = x[8 + ((compressed >> 2) & 7)];
+        } else if ((compressed & 0xE003) == 0xC002) {
+            // c.swsp
+            uint32_t offset = ((compressed >> 7) & 0x3C) | ((compressed >> 1) & 0xC0);
+            store->address = x[2] + offset;
+            store->value = x[(compressed >> 2) & 31];
+        } else {
+            return 0;
+        }
+        store->length = 4;
+        instructionlength = 2;
+    }
+
+    // A store that traps goes to the trap handler instead of the next instruction and writes nothing.
+    if (state->programcounter != programcounter + instructionlength) {
+        return 0;
+    }
+    if (store->length < 4) {
+        store->value &= (UINT32_C(1) << (store->length * 8)) - 1;
+    }
+    store->programcounter = programcounter;
+    return 1;
+}
+
+void ReplayWatch(Replay_t *replay, uint32_t programcounter) {
+    ReplayStore_t store;
+    if (storeOf(&instance->state, programcounter, &store) &&
+        replay->watchaddress - store.address < store.length) {
+        store.loopcounter = instance->loopcounter;
+        replay->found = store;
+        replay->hasfound = 1;
+    }
+}
+
+int ReplayStepBack(Replay_t *replay, size_t end, size_t count, FILE *log) {
+    if (replay->snapshotcount == 0 ||
+        count > end - replay->snapshots[0].loopcounter) {
+        fprintf(log, "Cannot step back %zu instructions, only the last %zu are recorded.\n",
+                count,
+                replay->snapshotcount != 0 ? end - replay->snapshots[0].loopcounter : 0);
+        return 1;
+    }
+
+    size_t loopcounter = end - count;
+    size_t index = findSnapshot(replay, loopcounter);
+    if (restoreSnapshot(replay, index) != 0) {
+        fprintf(log, "Cannot move the UART input back to instruction %zu.\n", replay->snapshots[index].loopcounter);
+        return 1;
+    }
+    runTo(loopcounter);
+    if (instance->loopcounter != loopcounter) {
+        fprintf(log, "Executing again stopped at instruction %zu.\n", instance->loopcounter);
+        return 1;
+    }
+
+    const RiscvEmulatorState_t *state = &instance->state;
+    fprintf(log, "Stepped back %zu from the end to after instruction %zu, pc: 0x%08X%s.\n",
+            count,
+            loopcounter,
+            state->programcounter,
+            SymbolsDescribe(&instance->symbols, state->programcounter));
+    for (uint8_t i = 0; i < 32; i += 4) {
+        fprintf(log, "x%-2u 0x%08X  x%-2u 0x%08X  x%-2u 0x%08X  x%-2u 0x%08X\n",
+                i, state->reg.x[i],
+                i + 1, state->reg.x[i + 1],
+                i + 2, state->reg.x[i + 2],
+                i + 3, state->reg.x[i + 3]);
+    }
+    return 0;
+}
+
+int ReplayLastWrite(Replay_t *replay, size_t end, uint32_t address, FILE *log) {
+    size_t page = pageIndex(address);
+    if (page == SIZE_MAX) {
+        fprintf(log, "Only stores to RAM and ROM are recorded, 0x%08X is in neither.\n", address);
+        return 1;
+    }
+    if (replay->snapshotcount == 0 ||
+        !isDirty(page)) {
+        fprintf(log, "Nothing stored to 0x%08X.\n", address);
+        return 0;
+    }
+
+    // The first store to the page came before the snapshot that first found it dirty, earlier snapshots are not
+    // worth executing again.
+    size_t oldest = 0;
+    if (replay->firstdirty[page] == UINT32_MAX) {
+        oldest = replay->snapshotcount - 1;
+    } else if (replay->firstdirty[page] > 0) {
+        oldest = replay->firstdirty[page] - 1;
+    }
+
+    replay->watchaddress = address;
+    replay->hasfound = 0;
+    for (size_t index = replay->snapshotcount; index-- > oldest && !replay->hasfound;) {
+        size_t stop = index + 1 < replay->snapshotcount ? replay->snapshots[index + 1].loopcounter : end;
+        if (restoreSnapshot(replay, index) != 0) {
+            fprintf(log, "Cannot move the UART input back to instruction %zu.\n", replay->snapshots[index].loopcounter);
+            return 1;
+        }
+        replay->watching = 1;
+        runTo(stop);
+        replay->watching = 0;
+    }
+
+    if (!replay->hasfound) {
+        fprintf(log, "No store to 0x%08X after instruction %zu.\n",
+                address,
+                replay->snapshots[oldest].loopcounter);
+        return 0;
+    }
+
+    const ReplayStore_t *store = &replay->found;
+    fprintf(log, "Last store to 0x%08X: instruction %zu, pc: 0x%08X%s, wrote 0x%0*X to 0x%08X.\n",
+            address,
+            store->loopcounter,
+            store->programcounter,
+            SymbolsDescribe(&instance->symbols, store->programcounter),
+            store->length * 2,
+            store->value,
+            store->address);
+    return 0;
+}
@@ -0,0 +1,814 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <RiscvEmulator.h>
+
+#include "callgraph.h"
+#include "checkpoint.h"
+#include "clint.h"
+#include "delta.h"
+#include "device.h"
+#include "elfload.h"
+#include "guard.h"
+#include "hook.h"
+#include "image.h"
+#include "instance.h"
+#include "lockstep.h"
+#include "memory.h"
+#include "options.h"
+#include "profile.h"
+#include "region.h"
+#include "replay.h"
+#include "run.h"
+#include "signature.h"
+#include "symbols.h"
+#include "uart.h"
+
+_Thread_local Instance_t *instance;
+
+void RunPath(char *path, size_t size, const char *directory, const char *name) {
+    if (name[0] == '/' ||
+        strcmp(directory, ".") == 0) {
+        snprintf(path, size, "%s", name);
+    } else {
+        snprintf(path, size, "%s/%s", directory, name);
+    }
+}
+
+/**
+ * Looks at a backward jump for a guest that is stuck.
+ *
+ * @param from The address of the jump.
+ */
+static void checkLoop(uint32_t from) {
+    RiscvEmulatorState_t *state = &instance->state;
+
+    // Waiting for the timer is not a hang.
+    if (ClintCanWake(&instance->clint, state)) {
+        if (state->programcounter == from) {
+            ClintFastForward(&instance->clint);
+        }
+        return;
+    }
+
+    if (state->programcounter == from) {
+        fprintf(instance->log, "pc: 0x%08X%s jumps to itself, stopping emulation.\n",
+                from,
+                SymbolsDescribe(&instance->symbols, from));
+        instance->pleasestop = STOP_HANG;
+        return;
+    }
+
+    if (instance->hang.armed &&
+        HangCheck(&instance->hang,
+                  state,
+                  instance->bus.accesses,
+                  instance->memory,
+                  instance->layout.ramlength,
+                  instance->dirty,
+                  instance->layout.ramorigin >> REGION_PAGE_SHIFT)) {
+        fprintf(instance->log, "pc: 0x%08X%s loops without changing anything, stopping emulation.\n",
+                state->programcounter,
+                SymbolsDescribe(&instance->symbols, state->programcounter));
+        instance->pleasestop = STOP_HANG;
+    }
+}
+
+/**
+ * Checks what must hold after an instruction: x0 is zero and, with hooks, the instruction had a hook.
+ */
+static void checkInstruction(void) {
+    const RiscvEmulatorState_t *state = &instance->state;
+
+#if (RVE_E_HOOK == 1)
+    // If this prints then consider adding a hook in RiscvEmulatorHook.h and implementing it in hook.c.
+    if (state->hookexists == 0) {
+        fprintf(instance->log, "pc: 0x%08X%s, instruction: 0x%08X, ???\n",
+                state->programcounter,
+                SymbolsDescribe(&instance->symbols, state->programcounter),
+                state->instruction.value);
+
+        // instance->pleasestop = STOP_ILLEGALINSTRUCTION;
+    }
+#endif
+
+    if (state->reg.x[0] != 0) {
+        fprintf(instance->log, "Error: x0 must always be zero. x0 is now 0x%08X. Stop emulation.\n",
+                state->reg.x[0]);
+        instance->pleasestop = STOP_X0;
+    }
+}
+
+/**
+ * Handles what is due at nextevent: the instruction budget, the timer and the hang check.
+ */
+static void handleEvent(void) {
+    if (instance->loopcounter >= instance->maxloopcounter) {
+        fprintf(instance->log, "Loopcounter limit reached, stopping emulation.\n");
+        instance->pleasestop = STOP_LOOPCOUNTER;
+        return;
+    }
+
+    size_t timer = ClintCheck(&instance->clint, &instance->state);
+    instance->nextevent = timer < instance->maxloopcounter ? timer : instance->maxloopcounter;
+
+    instance->hang.armed = 1;
+    if (instance->nextevent - instance->loopcounter > HANG_INTERVAL) {
+        instance->nextevent = instance->loopcounter + HANG_INTERVAL;
+    }
+}
+
+/**
+ * Counts an executed instruction for --profile and --callgraph, looks at it for --last-write and stops before the
+ * pc of --checkpoint-pc.
+ */
+static inline void profileInstruction(uint32_t programcounter) {
+    if (instance->profile.counts[0] != NULL) {
+        ProfileCount(&instance->profile, programcounter);
+    }
+    if (instance->callgraph.frames != NULL) {
+        CallgraphStep(&instance->callgraph,
+                      programcounter,
+                      instance->state.instruction.value,
+                      instance->state.programcounter,
+                      instance->loopcounter);
+    }
+    if (instance->replay.watching) {
+        ReplayWatch(&instance->replay, programcounter);
+    }
+    if (instance->breakpoint &&
+        instance->state.programcounter == instance->breakpointprogramcounter) {
+        instance->pleasestop = STOP_BREAKPOINT;
+    }
+}
+
+uint8_t RunInstructions(size_t count) {
+    RiscvEmulatorState_t *state = &instance->state;
+    size_t end = count > SIZE_MAX - instance->loopcounter ? SIZE_MAX : instance->loopcounter + count;
+
+    while (instance->pleasestop == STOP_NONE &&
+           instance->loopcounter < end) {
+        // Nothing but the instructions themselves runs until the next event or the end of the call. Devices
+        // lower nextevent when the guest changes them, the end of the call is no event.
+        while (instance->loopcounter < instance->nextevent &&
+               instance->loopcounter < end) {
+            uint32_t programcounter = state->programcounter;
+            instance->loopcounter++;
+            RiscvEmulatorLoop(state);
+
+            if (instance->profiling) {
+                profileInstruction(programcounter);
+            }
+
+            // Loops are where a guest gets stuck, only they are looked at.
+            if (state->programcounter <= programcounter) {
+                checkLoop(programcounter);
+            }
+
+#if (RVE_E_HOOK == 1)
+            // Debug builds check every instruction.
+            checkInstruction();
+#endif
+
+#if (RVE_E_ZICSR == 1)
+            // Nothing happens until the timer, if it is going to.
+            if (state->instruction.value == INSTRUCTION_WFI) {
+                ClintFastForward(&instance->clint);
+            }
+#endif
+
+            if (instance->pleasestop != STOP_NONE) {
+                break;
+            }
+        }
+
+#if (RVE_E_HOOK == 0)
+        // Release builds only notice a broken x0 at the end of a run of instructions.
+        checkInstruction();
+#endif
+
+        // An event that falls on the end of the call is handled at the start of the next one, the caller sees the
+        // instance as it was after the last instruction.
+        if (instance->pleasestop == STOP_NONE &&
+            instance->loopcounter >= instance->nextevent &&
+            instance->loopcounter < end) {
+            handleEvent();
+        }
+    }
+
+    return instance->pleasestop;
+}
+
+/**
+ * Where and when emulate writes a checkpoint.
+ */
+typedef struct {
+    const char *path;
+    size_t instructions;
+    uint32_t programcounter;
+    uint8_t atprogramcounter;
+} CheckpointAt_t;
+
+#if (RVE_E_HOOK == 1)
+/**
+ * Passes a hook event to the comparison with the reference.
+ */
+static void compareEvent(const HookEvent_t *event, void *argument) {
+    LockstepEvent(argument, event);
+}
+#endif
+
+/**
+ * Runs until the checkpoint is due and writes it.
+ */
+static void takeCheckpoint(const CheckpointAt_t *checkpoint) {
+    if (checkpoint->atprogramcounter) {
+        if (instance->state.programcounter != checkpoint->programcounter) {
+            uint8_t profiling = instance->profiling;
+            instance->profiling = 1;
+            instance->breakpoint = 1;
+            instance->breakpointprogramcounter = checkpoint->programcounter;
+            while (RunInstructions(SIZE_MAX) == STOP_NONE) {
+            }
+            instance->breakpoint = 0;
+            instance->profiling = profiling;
+            if (instance->pleasestop == STOP_BREAKPOINT) {
+                instance->pleasestop = STOP_NONE;
+            }
+        }
+    } else if (instance->loopcounter < checkpoint->instructions) {
+        RunInstructions(checkpoint->instructions - instance->loopcounter);
+    }
+
+    if (instance->pleasestop != STOP_NONE) {
+        fprintf(instance->log, "The test stopped before the checkpoint.\n");
+        return;
+    }
+    fprintf(instance->log, "Writing checkpoint at instruction %zu, pc: 0x%08X%s.\n",
+            instance->loopcounter,
+            instance->state.programcounter,
+            SymbolsDescribe(&instance->symbols, instance->state.programcounter));
+    if (CheckpointWrite(checkpoint->path) != 0) {
+        fprintf(instance->log, "Writing %s failed.\n", checkpoint->path);
+    }
+}
+
+/**
+ * Runs the emulator until something asks it to stop, writing a checkpoint on the way when argument is one.
+ */
+static void emulate(void *argument) {
+    instance->nextevent = 0;
+
+    if (argument != NULL) {
+        takeCheckpoint(argument);
+    }
+
+    if (instance->replay.interval != 0 &&
+        ReplaySnapshot(&instance->replay) == 0) {
+        while (RunInstructions(instance->replay.interval) == STOP_NONE) {
+            if (ReplaySnapshot(&instance->replay) != 0) {
+                fprintf(instance->log, "Not enough memory for more snapshots, the rest of the run is not recorded.\n");
+                break;
+            }
+        }
+    }
+
+    while (RunInstructions(SIZE_MAX) == STOP_NONE) {
+    }
+}
+
+/**
+ * Answers --step-back and --last-write by executing parts of the run again.
+ */
+static void replayQuestions(void *argument) {
+    const Options_t *options = argument;
+    Replay_t *replay = &instance->replay;
+    FILE *log = instance->log;
+
+    // The instruction that stopped the run, like the exit ecall or an access outside RAM and ROM, stored nothing
+    // and is not executed again. After the budget, a hang or a divergence the last instruction completed.
+    size_t end = instance->loopcounter;
+    size_t complete = end;
+    if (instance->pleasestop != STOP_NONE &&
+        instance->pleasestop != STOP_LOOPCOUNTER &&
+        instance->pleasestop != STOP_HANG &&
+        instance->pleasestop != STOP_DIVERGED) {
+        complete--;
+    }
+
+    if (options->stepback != 0) {
+        ReplayStepBack(replay, end, options->stepback, log);
+    }
+    if (options->findlastwrite) {
+        instance->profiling = 1;
+        ReplayLastWrite(replay, complete, options->lastwrite, log);
+    }
+}
+
+/**
+ * Adds a device to the bus of the instance unless it would hide RAM or ROM.
+ */
+static void attachDevice(Device_t *device) {
+    const MemoryLayout_t *layout = &instance->layout;
+    uint64_t end = (uint64_t)device->origin + device->length;
+
+    if ((device->origin < (uint64_t)layout->ramorigin + layout->ramlength && layout->ramorigin < end) ||
+        (device->origin < (uint64_t)layout->romorigin + layout->romlength && layout->romorigin < end) ||
+        DeviceAttach(&instance->bus, instance->regions, device) != 0) {
+        fprintf(instance->log, "No %s at 0x%08X, the address is already in use.\n", device->name, device->origin);
+    }
+}
+
+/**
+ * Reads dut-ram.bin, dut-rom.bin and dut-ram-signature_begin_end.txt from a test directory. Returns 0 on success.
+ */
+static int loadBinaries(const char *directory, const Options_t *options, ElfImage_t *image) {
+    FILE *log = instance->log;
+    const MemoryLayout_t *layout = &instance->layout;
+    char path[RUN_PATH_LENGTH];
+
+    memset(image, 0, sizeof(ElfImage_t));
+
+    fprintf(log, "Reading dut-ram.bin\n");
+    RunPath(path, sizeof(path), directory, "dut-ram.bin");
+    if (ImageLoad(path, instance->memory, layout->ramlength, options->mmap, &image->ramsize) != 0) {
+        fprintf(log, "file not found.\n");
+        return 1;
+    }
+    fprintf(log, "Read %zu bytes.\n", image->ramsize);
+
+    fprintf(log, "Reading dut-rom.bin\n");
+    RunPath(path, sizeof(path), directory, "dut-rom.bin");
+    if (ImageLoad(path, instance->firmware, layout->romlength, options->mmap, &image->romsize) != 0) {
+        fprintf(log, "file not found.\n");
+        return 2;
+    }
+    fprintf(log, "Read %zu bytes.\n", image->romsize);
+    image->codesize = image->romsize;
+
+    fprintf(log, "Parsing dut-ram-signature_begin_end.txt\n");
+    RunPath(path, sizeof(path), directory, "dut-ram-signature_begin_end.txt");
+    FILE *fsignature = fopen(path, "r");
+    if (fsignature == NULL) {
+        fprintf(log, "file not found.\n");
+        return 2;
+    }
+    char ssignaturebegin[20];
+    char *resultbegin;
+    char ssignatureend[20];
+    char *resultend;
+    resultbegin = fgets(ssignaturebegin, sizeof(ssignaturebegin), fsignature);
+    if (resultbegin == NULL) {
+        fprintf(log, "reading 1st line of dut-ram-signature_begin_end.txt failed.\n");
+        fclose(fsignature);
+        return 3;
+    }
+    resultend = fgets(ssignatureend, sizeof(ssignatureend), fsignature);
+    if (resultend == NULL) {
+        fprintf(log, "reading 2nd line of dut-ram-signature_begin_end.txt failed.\n");
+        fclose(fsignature);
+        return 3;
+    }
+    image->signaturebegin = strtol(ssignaturebegin, NULL, 16);
+    image->signatureend = strtol(ssignatureend, NULL, 16);
+    image->hassignature = 1;
+    fclose(fsignature);
+
+    image->entry = layout->romorigin;
+    return 0;
+}
+
+/**
+ * Emulates the test in a directory with the instance of this thread.
+ */
+static int runInstance(const char *directory, const Options_t *options) {
+    FILE *log = instance->log;
+    const MemoryLayout_t *layout = &instance->layout;
+    char path[RUN_PATH_LENGTH];
+
+    if (options->tracebinary != NULL) {
+#if (RVE_E_HOOK == 1)
+        RunPath(path, sizeof(path), directory, options->tracebinary);
+        fprintf(log, "Writing binary trace to %s\n", path);
+        if (HookSetOutput(HOOKOUTPUT_BINARY, path) != 0) {
+            return 4;
+        }
+#else
+        fprintf(log, "Hooks are not compiled in, there is nothing to trace.\n");
+#endif
+    }
+
+    if (options->flightrecorder > 0) {
+#if (RVE_E_HOOK == 1)
+        if (HookSetRing(options->flightrecorder) != 0) {
+            return 4;
+        }
+#else
+        fprintf(log, "Hooks are not compiled in, there is nothing to record.\n");
+#endif
+    }
+
+    if (options->profile != NULL) {
+#if (RVE_E_HOOK == 1)
+        if (HookSetProfile() != 0) {
+            return 4;
+        }
+#else
+        fprintf(log, "Hooks are not compiled in, the profile has no instruction names.\n");
+#endif
+    }
+
+    if (options->lockstep != NULL) {
+#if (RVE_E_HOOK == 1)
+        if (strcmp(options->lockstep, "-") == 0) {
+            snprintf(path, sizeof(path), "-");
+        } else {
+            RunPath(path, sizeof(path), directory, options->lockstep);
+        }
+        fprintf(log, "Comparing with %s\n", path);
+        if (LockstepOpen(&instance->lockstep, path, log) != 0) {
+            return 4;
+        }
+        HookSetListener(compareEvent, &instance->lockstep);
+#else
+        fprintf(log, "Hooks are not compiled in, there is nothing to compare.\n");
+#endif
+    }
+
+    ElfImage_t image;
+    if (options->elf != NULL) {
+        RunPath(path, sizeof(path), directory, options->elf);
+        fprintf(log, "Loading %s\n", path);
+        if (ElfLoad(path, layout, instance->memory, instance->firmware, &image, &instance->symbols, log) != 0) {
+            return 2;
+        }
+        if (!image.hassignature) {
+            fprintf(log, "begin_signature and end_signature are not in the symbol table.\n");
+            return 3;
+        }
+        fprintf(log, "Loaded 0x%zX bytes of RAM and 0x%zX bytes of ROM.\n", image.ramsize, image.romsize);
+    } else {
+        int result = loadBinaries(directory, options, &image);
+        if (result != 0) {
+            return result;
+        }
+        if (options->symbols != NULL) {
+            RunPath(path, sizeof(path), directory, options->symbols);
+            if (ElfLoadSymbols(path, &instance->symbols, log) != 0) {
+                return 4;
+            }
+        }
+    }
+    HookSetSymbols(&instance->symbols);
+    size_t ramsize = image.ramsize;
+
+    // Without a budget every word of code may run five times, an ELF may have its code in RAM.
+    instance->maxloopcounter = options->maxinstructions != 0 ? options->maxinstructions : (image.codesize / 4) * 5;
+
+    uint32_t signaturebegin = image.signaturebegin;
+    uint32_t signatureend = image.signatureend;
+    if (signaturebegin > signatureend) {
+        uint32_t t = signatureend;
+        signatureend = signaturebegin;
+        signaturebegin = t;
+    }
+    fprintf(log, "Signature in RAM between 0x%08X 0x%08X.\n", signaturebegin, signatureend);
+
+    if (!SignatureValid(layout, signaturebegin, signatureend)) {
+        fprintf(log, "Signature is not inside RAM.\n");
+        return 3;
+    }
+
+    FILE *uartoutput = log;
+    if (options->uartoutput != NULL) {
+        RunPath(path, sizeof(path), directory, options->uartoutput);
+        uartoutput = fopen(path, "wb");
+        if (uartoutput == NULL) {
+            fprintf(log, "Cannot create %s.\n", path);
+            return 4;
+        }
+    }
+    FILE *uartinput = NULL;
+    if (options->uartinput != NULL) {
+        RunPath(path, sizeof(path), directory, options->uartinput);
+        uartinput = fopen(path, "rb");
+        if (uartinput == NULL) {
+            fprintf(log, "Cannot open %s.\n", path);
+            if (uartoutput != log) {
+                fclose(uartoutput);
+            }
+            return 4;
+        }
+    }
+    if (UartInit(&instance->uart, IO_ORIGIN, uartoutput, uartinput) == 0) {
+        attachDevice(&instance->uart.device);
+    }
+    ClintInit(&instance->clint, CLINT_ORIGIN, &instance->loopcounter, &instance->nextevent, &instance->state, &instance->bus, &instance->stores);
+    attachDevice(&instance->clint.device);
+
+    fprintf(log, "RiscvEmulatorInit()\n");
+
+    RiscvEmulatorInit(&instance->state, layout->ramlength);
+
+    // The emulator starts at ROM_ORIGIN with the stack at the end of RAM. Start at the entry of the image instead,
+    // the start of ROM for dut-rom.bin, and move the stack along with the layout.
+    instance->state.programcounter = image.entry;
+    if (instance->state.reg.sp != 0) {
+        instance->state.reg.sp = instance->state.reg.sp - RAM_ORIGIN + layout->ramorigin;
+    }
+
+    if (options->restore != NULL) {
+        RunPath(path, sizeof(path), directory, options->restore);
+        fprintf(log, "Restoring %s\n", path);
+        if (CheckpointRestore(path, log) != 0) {
+            UartClose(&instance->uart);
+            if (uartoutput != log) {
+                fclose(uartoutput);
+            }
+            if (uartinput != NULL) {
+                fclose(uartinput);
+            }
+            return 2;
+        }
+        fprintf(log, "Continuing at instruction %zu, pc: 0x%08X%s.\n",
+                instance->loopcounter,
+                instance->state.programcounter,
+                SymbolsDescribe(&instance->symbols, instance->state.programcounter));
+    }
+
+    // Not before the restore, which maps pages of the checkpoint over ROM.
+#if (RVE_GUARDMAPPING == 1)
+    GuardReadOnly(instance->guest, layout->romorigin, layout->romlength);
+#endif
+
+    if (options->record != 0 &&
+        ReplayInit(&instance->replay, options->record, ramsize, image.romsize) != 0) {
+        fprintf(log, "Not enough memory to record the run.\n");
+    }
+
+    if (options->callgraph != NULL &&
+        CallgraphInit(&instance->callgraph, instance->state.programcounter) != 0) {
+        fprintf(log, "Not enough memory for the call graph.\n");
+    }
+
+    char checkpointpath[RUN_PATH_LENGTH];
+    CheckpointAt_t checkpoint = {
+        .path = checkpointpath,
+        .instructions = options->checkpointat,
+        .programcounter = options->checkpointpc,
+        .atprogramcounter = options->checkpointatpc,
+    };
+    if (options->checkpoint != NULL) {
+        RunPath(checkpointpath, sizeof(checkpointpath), directory, options->checkpoint);
+    }
+    void *argument = options->checkpoint != NULL ? &checkpoint : NULL;
+
+#if (RVE_GUARDMAPPING == 1)
+    uint8_t fault = GuardCall(emulate, argument);
+    if (fault != STOP_NONE) {
+        fprintf(log, "%s 0x%08X is outside RAM and ROM. Stopping emulation.\n",
+                fault == STOP_STOREOUTOFRANGE ? "Writing to" : "Loading from",
+                instance->faultaddress);
+        instance->pleasestop = fault;
+    }
+#else
+    emulate(argument);
+#endif
+
+    // The input stays open for executing parts of the run again.
+    UartClose(&instance->uart);
+    if (uartoutput != log) {
+        fclose(uartoutput);
+    }
+
+    LockstepClose(&instance->lockstep);
+
+    // Only a stop that is not a requested exit needs the recorded events.
+    if (instance->pleasestop > STOP_EXIT) {
+        HookDumpRing(log);
+    }
+
+    if (options->profile != NULL) {
+        fprintf(log, "Writing profile\n");
+        RunPath(path, sizeof(path), directory, options->profile);
+        if (ProfileWrite(&instance->profile, path, &instance->symbols) != 0) {
+            fprintf(log, "Writing %s failed.\n", path);
+        }
+    }
+    if (options->profilelisting != NULL) {
+        fprintf(log, "Writing annotated listing\n");
+        char rompath[RUN_PATH_LENGTH];
+        RunPath(rompath, sizeof(rompath), directory, options->elf != NULL ? options->elf : "dut-rom.bin");
+        RunPath(path, sizeof(path), directory, options->profilelisting);
+        if (ProfileWriteListing(&instance->profile, path, rompath, options->elf != NULL, log) != 0) {
+            fprintf(log, "Writing %s failed.\n", path);
+        }
+    }
+    if (options->callgraph != NULL) {
+        fprintf(log, "Writing call graph\n");
+        RunPath(path, sizeof(path), directory, options->callgraph);
+        if (CallgraphWrite(&instance->callgraph,
+                           path,
+                           instance->loopcounter,
+                           options->elf != NULL ? options->elf : "dut-rom.bin",
+                           &instance->symbols) != 0) {
+            fprintf(log, "Writing %s failed.\n", path);
+        }
+    }
+    HookClose();
+
+    switch (options->ramafter) {
+        case RAMAFTER_FULL: {
+            fprintf(log, "Writing dut-ram-after.bin\n");
+            RunPath(path, sizeof(path), directory, "dut-ram-after.bin");
+            FILE *framafter = fopen(path, "wb");
+            size_t writtenbytesframatfer = fwrite(instance->memory, sizeof(uint8_t), ramsize, framafter);
+            fprintf(log, "Wrote %zu bytes.\n", writtenbytesframatfer);
+            fclose(framafter);
+            break;
+        }
+        case RAMAFTER_DELTA: {
+            fprintf(log, "Writing dut-ram-after.delta\n");
+            RunPath(path, sizeof(path), directory, "dut-ram-after.delta");
+            long pages = DeltaWrite(path, instance->memory, ramsize, instance->dirty, layout->ramorigin >> REGION_PAGE_SHIFT);
+            fprintf(log, "Wrote %ld changed pages.\n", pages);
+            break;
+        }
+        case RAMAFTER_DIRTY: {
+            fprintf(log, "Writing dut-ram-after.bin\n");
+            char original[RUN_PATH_LENGTH];
+            RunPath(original, sizeof(original), directory, "dut-ram.bin");
+            RunPath(path, sizeof(path), directory, "dut-ram-after.bin");
+            long pages = DeltaWriteDirty(path, original, instance->memory, ramsize, instance->dirty, layout->ramorigin >> REGION_PAGE_SHIFT);
+            fprintf(log, "Wrote %ld changed pages over a copy of dut-ram.bin.\n", pages);
+            break;
+        }
+    }
+
+    fprintf(log, "Writing DUT-rve.signature\n");
+    RunPath(path, sizeof(path), directory, "DUT-rve.signature");
+    if (SignatureWrite(path, instance->memory, layout, signaturebegin, signatureend) != 0) {
+        fprintf(log, "Writing DUT-rve.signature failed.\n");
+    }
+
+    if (options->stats) {
+#if (RVE_GUARDMAPPING == 1)
+        fprintf(log, "Pages of ROM stored to: %zu.\n", instance->romstores);
+#else
+        fprintf(log, "Loads from ROM: %zu, stores to ROM: %zu.\n",
+                instance->romloads,
+                instance->romstores);
+#endif
+        fprintf(log, "Timer ticks skipped while idle: %llu.\n", (unsigned long long)instance->clint.skipped);
+    }
+
+    fprintf(log, "Stopped at pc: 0x%08X%s.\n",
+            instance->state.programcounter,
+            SymbolsDescribe(&instance->symbols, instance->state.programcounter));
+    fprintf(log, "Simulated %zu CPU instructions.\n", instance->loopcounter);
+
+    int result = 0;
+    if (instance->pleasestop == STOP_HANG) {
+        result = RUN_HANG;
+    } else if (instance->pleasestop == STOP_DIVERGED) {
+        result = RUN_DIVERGED;
+    }
+
+    if (instance->replay.interval != 0 &&
+        (options->stepback != 0 || options->findlastwrite)) {
+        // Everything is written, what is executed again must not show up in the trace, the profile or the call graph.
+        HookClose();
+        HookSetOutput(HOOKOUTPUT_NONE, NULL);
+        ProfileFree(&instance->profile);
+        CallgraphFree(&instance->callgraph);
+
+#if (RVE_GUARDMAPPING == 1)
+        if (GuardCall(replayQuestions, (void *)options) != STOP_NONE) {
+            fprintf(log, "Executing again went outside RAM and ROM.\n");
+        }
+#else
+        replayQuestions((void *)options);
+#endif
+    }
+    if (uartinput != NULL) {
+        fclose(uartinput);
+    }
+
+    fprintf(log, "Exiting.\n");
+    return result;
+}
+
+/**
+ * Sets up RAM, ROM and the dirty bits of the instance. Returns 0 on success.
+ */
+static int allocateMemory(const Options_t *options) {
+    instance->dirty = (uint64_t *)ImageAllocate(REGION_PAGES / 8);
+    if (instance->dirty == NULL) {
+        return 1;
+    }
+
+    const MemoryLayout_t *layout = &instance->layout;
+
+    if (options->profile != NULL &&
+        ProfileInit(&instance->profile, layout) != 0) {
+        return 1;
+    }
+    instance->profiling = options->profile != NULL || options->callgraph != NULL;
+
+    // Only for the devices when RAM and ROM are guard-mapped.
+    instance->regions = RegionAllocate();
+    if (instance->regions == NULL) {
+        return 1;
+    }
+
+#if (RVE_GUARDMAPPING == 1)
+    (void)options;
+    instance->guest = GuardReserve();
+    if (instance->guest == NULL ||
+        GuardMap(instance->guest, layout->ramorigin, layout->ramlength, 1) != 0 ||
+        GuardMap(instance->guest, layout->romorigin, layout->romlength, 0) != 0) {
+        return 1;
+    }
+    instance->memory = &instance->guest[layout->ramorigin];
+    instance->firmware = &instance->guest[layout->romorigin];
+#else
+    instance->memory = ImageAllocate(layout->ramlength);
+    instance->firmware = ImageAllocate(layout->romlength);
+    if (instance->memory == NULL ||
+        instance->firmware == NULL) {
+        return 1;
+    }
+
+    RegionMap(instance->regions, layout->ramorigin, instance->memory, layout->ramlength, REGION_LOAD | REGION_STORE);
+    // Counting ROM loads needs the slow path. ROM stores always take it.
+    if (!options->stats) {
+        RegionMap(instance->regions, layout->romorigin, instance->firmware, layout->romlength, REGION_LOAD);
+    }
+#endif
+
+    return 0;
+}
+
+static void freeMemory(void) {
+    ReplayFree(&instance->replay);
+    ProfileFree(&instance->profile);
+    CallgraphFree(&instance->callgraph);
+    SymbolsFree(&instance->symbols);
+#if (RVE_GUARDMAPPING == 1)
+    GuardRelease(instance->guest);
+#else
+    ImageFree(instance->memory, instance->layout.ramlength);
+    ImageFree(instance->firmware, instance->layout.romlength);
+#endif
+    RegionFree(instance->regions);
+    ImageFree((uint8_t *)instance->dirty, REGION_PAGES / 8);
+}
+
+int RunApplyDelta(const char *directory, FILE *log) {
+    char deltapath[RUN_PATH_LENGTH];
+    char original[RUN_PATH_LENGTH];
+    char path[RUN_PATH_LENGTH];
+    RunPath(deltapath, sizeof(deltapath), directory, "dut-ram-after.delta");
+    RunPath(original, sizeof(original), directory, "dut-ram.bin");
+    RunPath(path, sizeof(path), directory, "dut-ram-after.bin");
+
+    return DeltaApply(deltapath, original, path, log);
+}
+
+int RunTest(const char *directory, const Options_t *options, FILE *log) {
+    instance = calloc(1, sizeof(Instance_t));
+    if (instance == NULL) {
+        fprintf(log, "Not enough memory for an emulator instance.\n");
+        return 4;
+    }
+
+    instance->layout = options->layout;
+    if (allocateMemory(options) != 0) {
+        fprintf(log, "Not enough memory for RAM and ROM.\n");
+        freeMemory();
+        free(instance);
+        instance = NULL;
+        return 4;
+    }
+
+    instance->log = log;
+    HookSetLog(log);
+
+    int result = runInstance(directory, options);
+
+    // runInstance leaves the reference open when it fails early.
+    LockstepClose(&instance->lockstep);
+    HookClose();
+    freeMemory();
+    free(instance);
+    instance = NULL;
+    return result;
+}
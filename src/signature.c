@@ -0,0 +1,104 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "signature.h"
+
+// Length in bytes of a formatted word, "%08x\n".
+#define SIGNATURE_LINE_LENGTH 9
+
+/**
+ * The two hexadecimal digits of every byte value.
+ */
+static const char hexpair[256][2] = {
+#define HEXDIGIT(n) ((n) < 10 ? '0' + (n) : 'a' + (n) - 10)
+#define HEXPAIR(n)  {HEXDIGIT((n) >> 4), HEXDIGIT((n) & 0xF)}
+#define HEXROW(n)                                                                  \
+    HEXPAIR(n + 0x0), HEXPAIR(n + 0x1), HEXPAIR(n + 0x2), HEXPAIR(n + 0x3),       \
+        HEXPAIR(n + 0x4), HEXPAIR(n + 0x5), HEXPAIR(n + 0x6), HEXPAIR(n + 0x7),   \
+        HEXPAIR(n + 0x8), HEXPAIR(n + 0x9), HEXPAIR(n + 0xA), HEXPAIR(n + 0xB),   \
+        HEXPAIR(n + 0xC), HEXPAIR(n + 0xD), HEXPAIR(n + 0xE), HEXPAIR(n + 0xF)
+    HEXROW(0x00), HEXROW(0x10), HEXROW(0x20), HEXROW(0x30),
+    HEXROW(0x40), HEXROW(0x50), HEXROW(0x60), HEXROW(0x70),
+    HEXROW(0x80), HEXROW(0x90), HEXROW(0xA0), HEXROW(0xB0),
+    HEXROW(0xC0), HEXROW(0xD0), HEXROW(0xE0), HEXROW(0xF0),
+#undef HEXROW
+#undef HEXPAIR
+#undef HEXDIGIT
+};
+
+/**
+ * Number of words from begin up to end, a partial last word counts.
+ */
+static inline uint32_t wordCount(uint32_t begin, uint32_t end) {
+    return (uint32_t)(((uint64_t)end - begin + 3) / 4);
+}
+
+uint8_t SignatureValid(const MemoryLayout_t *layout, uint32_t begin, uint32_t end) {
+    if (begin > end ||
+        begin < layout->ramorigin) {
+        return 0;
+    }
+
+    uint64_t last = (uint64_t)begin + (uint64_t)wordCount(begin, end) * 4;
+    return last <= (uint64_t)layout->ramorigin + layout->ramlength;
+}
+
+int SignatureWrite(const char *path, const uint8_t *memory, const MemoryLayout_t *layout, uint32_t begin, uint32_t end) {
+    if (!SignatureValid(layout, begin, end)) {
+        return 1;
+    }
+
+    uint32_t words = wordCount(begin, end);
+    size_t length = (size_t)words * SIGNATURE_LINE_LENGTH;
+    char *buffer = malloc(length + 1);
+    if (buffer == NULL) {
+        return 2;
+    }
+
+    const uint8_t *word = &memory[begin - layout->ramorigin];
+    char *line = buffer;
+    for (uint32_t i = 0; i < words; i++) {
+        // Words are little endian, the most significant byte is printed first.
+        memcpy(&line[0], hexpair[word[3]], 2);
+        memcpy(&line[2], hexpair[word[2]], 2);
+        memcpy(&line[4], hexpair[word[1]], 2);
+        memcpy(&line[6], hexpair[word[0]], 2);
+        line[8] = '\n';
+        line += SIGNATURE_LINE_LENGTH;
+        word += 4;
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(buffer);
+        return 3;
+    }
+
+    // A single write for the whole file, only repeated when the kernel writes less.
+    int result = 0;
+    size_t written = 0;
+    while (written < length) {
+        ssize_t done = write(fd, &buffer[written], length - written);
+        if (done <= 0) {
+            result = 3;
+            break;
+        }
+        written += done;
+    }
+
+    if (close(fd) != 0) {
+        result = 3;
+    }
+    free(buffer);
+    return result;
+}
@@ -0,0 +1,137 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "symbols.h"
+
+// Initial number of symbols and bytes of names.
+#define SYMBOLS_CAPACITY 256
+
+int SymbolsAdd(SymbolTable_t *table, uint32_t address, const char *name) {
+    size_t length = strlen(name) + 1;
+
+    if (table->count == table->capacity) {
+        size_t capacity = table->capacity == 0 ? SYMBOLS_CAPACITY : table->capacity * 2;
+        Symbol_t *symbols = realloc(table->symbols, capacity * sizeof(Symbol_t));
+        if (symbols == NULL) {
+            return 1;
+        }
+        table->symbols = symbols;
+        table->capacity = capacity;
+    }
+    if (table->namelength + length > table->namecapacity) {
+        size_t capacity = table->namecapacity == 0 ? SYMBOLS_CAPACITY * 16 : table->namecapacity;
+        while (table->namelength + length > capacity) {
+            capacity *= 2;
+        }
+        char *names = realloc(table->names, capacity);
+        if (names == NULL) {
+            return 1;
+        }
+        table->names = names;
+        table->namecapacity = capacity;
+    }
+
+    memcpy(&table->names[table->namelength], name, length);
+    table->symbols[table->count].address = address;
+    table->symbols[table->count].name = table->namelength;
+    table->namelength += length;
+    table->count++;
+    return 0;
+}
+
+static int compareSymbols(const void *a, const void *b) {
+    const Symbol_t *left = a;
+    const Symbol_t *right = b;
+    if (left->address != right->address) {
+        return (left->address > right->address) - (left->address < right->address);
+    }
+    // Names are added in order, so the name offset keeps the sort stable.
+    return (left->name > right->name) - (left->name < right->name);
+}
+
+void SymbolsSort(SymbolTable_t *table) {
+    if (table->count == 0) {
+        return;
+    }
+
+    qsort(table->symbols, table->count, sizeof(Symbol_t), compareSymbols);
+
+    size_t kept = 1;
+    for (size_t i = 1; i < table->count; i++) {
+        if (table->symbols[i].address != table->symbols[kept - 1].address) {
+            table->symbols[kept++] = table->symbols[i];
+        }
+    }
+    table->count = kept;
+    table->cached = 0;
+}
+
+void SymbolsFree(SymbolTable_t *table) {
+    free(table->symbols);
+    free(table->names);
+    memset(table, 0, sizeof(SymbolTable_t));
+}
+
+const char *SymbolsFind(SymbolTable_t *table, uint32_t address, uint32_t *offset) {
+    if (table == NULL ||
+        table->count == 0 ||
+        address < table->symbols[0].address) {
+        return NULL;
+    }
+
+    size_t index = table->cached;
+    if (!(table->symbols[index].address <= address &&
+          (index + 1 == table->count || address < table->symbols[index + 1].address))) {
+        // The last symbol at or before address.
+        size_t low = 0;
+        size_t high = table->count;
+        while (high - low > 1) {
+            size_t middle = low + (high - low) / 2;
+            if (table->symbols[middle].address <= address) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        index = low;
+        table->cached = index;
+    }
+
+    *offset = address - table->symbols[index].address;
+    return &table->names[table->symbols[index].name];
+}
+
+int SymbolsFormat(SymbolTable_t *table, uint32_t address, char *buffer, size_t size) {
+    uint32_t offset;
+    const char *name = SymbolsFind(table, address, &offset);
+    if (name == NULL) {
+        buffer[0] = '\0';
+        return 1;
+    }
+
+    if (offset == 0) {
+        snprintf(buffer, size, "%s", name);
+    } else {
+        snprintf(buffer, size, "%s+0x%X", name, offset);
+    }
+    return 0;
+}
+
+const char *SymbolsDescribe(SymbolTable_t *table, uint32_t address) {
+    static _Thread_local char description[256];
+
+    char name[sizeof(description) - 3];
+    if (SymbolsFormat(table, address, name, sizeof(name)) != 0) {
+        return "";
+    }
+    snprintf(description, sizeof(description), " <%s>", name);
+    return description;
+}
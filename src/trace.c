@@ -0,0 +1,150 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hook.h"
+#include "trace.h"
+
+_Static_assert(sizeof(TraceNameRecord_t) == sizeof(HookEvent_t), "Name record must be the same size as an event record.");
+
+static _Thread_local FILE *tracefile;
+static _Thread_local uint8_t *tracebuffer;
+static _Thread_local size_t tracebufferused;
+
+static void flushTrace(void) {
+    if (tracebufferused > 0) {
+        fwrite(tracebuffer, sizeof(uint8_t), tracebufferused, tracefile);
+        tracebufferused = 0;
+    }
+}
+
+static inline void appendRecord(const void *record) {
+    if (tracebufferused + sizeof(HookEvent_t) > TRACE_BUFFER_SIZE) {
+        flushTrace();
+    }
+    memcpy(&tracebuffer[tracebufferused], record, sizeof(HookEvent_t));
+    tracebufferused += sizeof(HookEvent_t);
+}
+
+int TraceOpen(const char *path, FILE *log) {
+    tracebuffer = malloc(TRACE_BUFFER_SIZE);
+    if (tracebuffer == NULL) {
+        fprintf(log, "Not enough memory for the trace buffer.\n");
+        return 1;
+    }
+
+    tracefile = fopen(path, "wb");
+    if (tracefile == NULL) {
+        fprintf(log, "Could not create %s.\n", path);
+        free(tracebuffer);
+        tracebuffer = NULL;
+        return 1;
+    }
+
+    TraceHeader_t header = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .recordsize = sizeof(HookEvent_t),
+    };
+    fwrite(&header, sizeof(header), 1, tracefile);
+    tracebufferused = 0;
+    return 0;
+}
+
+void TraceWriteEvent(const HookEvent_t *event) {
+    appendRecord(event);
+}
+
+void TraceWriteName(uint8_t kind, uint16_t id, const char *name) {
+    TraceNameRecord_t record = {
+        .hook = kind,
+        .id = id,
+    };
+    strncpy(record.name, name, sizeof(record.name) - 1);
+    appendRecord(&record);
+}
+
+void TraceClose(void) {
+    if (tracefile == NULL) {
+        return;
+    }
+    flushTrace();
+    fclose(tracefile);
+    tracefile = NULL;
+    free(tracebuffer);
+    tracebuffer = NULL;
+}
+
+int TraceDecode(const char *path, FILE *out) {
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        printf("file not found.\n");
+        return 1;
+    }
+
+    TraceHeader_t header;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION ||
+        header.recordsize != sizeof(HookEvent_t)) {
+        printf("%s is not a trace written by this build.\n", path);
+        fclose(in);
+        return 2;
+    }
+
+    uint8_t *buffer = malloc(TRACE_BUFFER_SIZE);
+    if (buffer == NULL) {
+        printf("Not enough memory for the trace buffer.\n");
+        fclose(in);
+        return 3;
+    }
+
+    // Identifiers in the file to identifiers in this process.
+    static uint16_t instructionmap[HOOKINSTRUCTION_CAPACITY];
+    static uint8_t immnamemap[HOOKIMMNAME_CAPACITY];
+    for (uint16_t i = 0; i < HOOKINSTRUCTION_CAPACITY; i++) {
+        instructionmap[i] = i == HOOKINSTRUCTION_UNSET ? HOOKINSTRUCTION_UNSET : HOOKINSTRUCTION_UNKNOWN;
+    }
+    memset(immnamemap, 0, sizeof(immnamemap));
+
+    size_t records;
+    while ((records = fread(buffer, sizeof(HookEvent_t), TRACE_BUFFER_SIZE / sizeof(HookEvent_t), in)) > 0) {
+        for (size_t i = 0; i < records; i++) {
+            const uint8_t *record = &buffer[i * sizeof(HookEvent_t)];
+
+            if (record[0] == TRACE_RECORD_INSTRUCTIONNAME ||
+                record[0] == TRACE_RECORD_IMMNAME) {
+                TraceNameRecord_t name;
+                memcpy(&name, record, sizeof(name));
+                name.name[sizeof(name.name) - 1] = '\0';
+
+                if (name.hook == TRACE_RECORD_INSTRUCTIONNAME &&
+                    name.id < HOOKINSTRUCTION_CAPACITY) {
+                    instructionmap[name.id] = HookInternInstruction(name.name);
+                } else if (name.hook == TRACE_RECORD_IMMNAME &&
+                           name.id < HOOKIMMNAME_CAPACITY) {
+                    immnamemap[name.id] = HookInternImmediateName(name.name);
+                }
+                continue;
+            }
+
+            HookEvent_t event;
+            memcpy(&event, record, sizeof(event));
+            event.instructionid = event.instructionid < HOOKINSTRUCTION_CAPACITY ? instructionmap[event.instructionid] : HOOKINSTRUCTION_UNKNOWN;
+            event.immnameid = event.immnameid < HOOKIMMNAME_CAPACITY ? immnamemap[event.immnameid] : 0;
+            HookPrintEvent(out, &event);
+        }
+    }
+
+    free(buffer);
+    fclose(in);
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "uart.h"
+
+void UartFlush(Uart_t *uart) {
+    if (uart->used > 0) {
+        fwrite(uart->buffer, sizeof(uint8_t), uart->used, uart->output);
+        fflush(uart->output);
+        uart->used = 0;
+    }
+}
+
+static inline uint8_t dlab(const Uart_t *uart) {
+    return (uart->registers[UART_LCR] & UART_LCR_DLAB) != 0;
+}
+
+static uint32_t readRegister(Device_t *device, uint32_t offset, uint8_t length __attribute__((unused))) {
+    Uart_t *uart = (Uart_t *)device;
+
+    if (offset < sizeof(uart->divisor) &&
+        dlab(uart)) {
+        return uart->divisor[offset];
+    }
+
+    switch (offset) {
+        case UART_RBR_THR: {
+            if (uart->received == EOF) {
+                return 0;
+            }
+            uint8_t byte = uart->received;
+            uart->received = getc(uart->input);
+            return byte;
+        }
+        case UART_LSR: {
+            // Transmitting never has to wait.
+            uint8_t status = UART_LSR_THRE | UART_LSR_TEMT;
+            if (uart->received != EOF) {
+                status |= UART_LSR_DR;
+            }
+            return status;
+        }
+        default: {
+            if (offset < sizeof(uart->registers)) {
+                return uart->registers[offset];
+            }
+            return 0;
+        }
+    }
+}
+
+static void writeRegister(Device_t *device, uint32_t offset, uint32_t value, uint8_t length __attribute__((unused))) {
+    Uart_t *uart = (Uart_t *)device;
+
+    if (offset < sizeof(uart->divisor) &&
+        dlab(uart)) {
+        uart->divisor[offset] = value;
+        return;
+    }
+
+    if (offset == UART_RBR_THR) {
+        // After UartClose, while a run is executed again, there is nowhere to send to.
+        if (uart->buffer == NULL) {
+            return;
+        }
+        uart->buffer[uart->used++] = value;
+        if (uart->used == UART_BUFFER_SIZE) {
+            UartFlush(uart);
+        }
+    } else if (offset < sizeof(uart->registers) &&
+               offset != UART_LSR) {
+        uart->registers[offset] = value;
+    }
+}
+
+int UartInit(Uart_t *uart, uint32_t origin, FILE *output, FILE *input) {
+    memset(uart, 0, sizeof(Uart_t));
+
+    uart->buffer = malloc(UART_BUFFER_SIZE);
+    if (uart->buffer == NULL) {
+        return 1;
+    }
+
+    uart->device.name = "uart";
+    uart->device.origin = origin;
+    uart->device.length = REGION_PAGE_LENGTH;
+    uart->device.read = readRegister;
+    uart->device.write = writeRegister;
+    uart->output = output;
+    uart->input = input;
+    uart->received = input != NULL ? getc(input) : EOF;
+    return 0;
+}
+
+void UartClose(Uart_t *uart) {
+    if (uart->buffer != NULL) {
+        UartFlush(uart);
+        free(uart->buffer);
+        uart->buffer = NULL;
+    }
+    // The caller closes the files.
+}
+
+void UartSave(const Uart_t *uart, UartState_t *state) {
+    memset(state, 0, sizeof(UartState_t));
+    memcpy(state->registers, uart->registers, sizeof(state->registers));
+    memcpy(state->divisor, uart->divisor, sizeof(state->divisor));
+    state->received = uart->received;
+    state->inputoffset = uart->input != NULL ? ftell(uart->input) : -1;
+}
+
+int UartRestore(Uart_t *uart, const UartState_t *state) {
+    memcpy(uart->registers, state->registers, sizeof(uart->registers));
+    memcpy(uart->divisor, state->divisor, sizeof(uart->divisor));
+
+    // Without input nothing was or is received.
+    if (uart->input == NULL) {
+        uart->received = EOF;
+        return 0;
+    }
+    if (state->inputoffset < 0 ||
+        fseek(uart->input, state->inputoffset, SEEK_SET) != 0) {
+        return 1;
+    }
+    uart->received = state->received;
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+
+Copyright 2023-2025 Marc Ketel
+SPDX-License-Identifier: Apache-2.0
+
+*/
+
+#include <string.h>
+
+#include <unity.h>
+
+#include "lockstepparse.h"
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+/**
+ * Parses a whole Spike line the way readRecord does. Returns the format.
+ */
+static LockstepFormat_t parseSpike(const char *line, LockstepRecord_t *record) {
+    memset(record, 0, sizeof(LockstepRecord_t));
+    const char *writes = NULL;
+    LockstepFormat_t format = LockstepParseStart(line, &record->programcounter, &writes);
+    if (format == LOCKSTEP_FORMAT_SPIKE) {
+        LockstepParseSpikeWrites(writes, record);
+    }
+    return format;
+}
+
+static void testSpikeRegisterWrite(void) {
+    LockstepRecord_t record;
+    TEST_ASSERT_EQUAL_INT(LOCKSTEP_FORMAT_SPIKE, parseSpike("core   0: 3 0x80000000 (0x00000297) x5  0x80000000", &record));
+    TEST_ASSERT_EQUAL_HEX32(0x80000000, record.programcounter);
+    TEST_ASSERT_EQUAL_UINT8(1, record.hasrd);
+    TEST_ASSERT_EQUAL_UINT8(5, record.rdnum);
+    TEST_ASSERT_EQUAL_HEX32(0x80000000, record.rd);
+    TEST_ASSERT_EQUAL_UINT8(0, record.hasstore);
+}
+
+static void testSpikeSignExtended(void) {
+    LockstepRecord_t record;
+    TEST_ASSERT_EQUAL_INT(LOCKSTEP_FORMAT_SPIKE,
+                          parseSpike("core   0: 3 0xffffffff80000004 (0xfff00513) x10 0xffffffffffffffff", &record));
+    TEST_ASSERT_EQUAL_HEX32(0x80000004, record.programcounter);
+    TEST_ASSERT_EQUAL_UINT8(10, record.rdnum);
+    TEST_ASSERT_EQUAL_HEX32(0xFFFFFFFF, record.rd);
+}
+
+static void testSpikeStore(void) {
+    LockstepRecord_t record;
+    TEST_ASSERT_EQUAL_INT(LOCKSTEP_FORMAT_SPIKE,
+                          parseSpike("core   0: 3 0x80000010 (0x00532023) mem 0x80001000 0x00000005", &record));
+    TEST_ASSERT_EQUAL_UINT8(0, record.hasrd);
+    TEST_ASSERT_EQUAL_UINT8(1, record.hasstore);
+    TEST_ASSERT_EQUAL_HEX32(0x80001000, record.memorylocation);
+    TEST_ASSERT_EQUAL_HEX32(0x00000005, record.value);
+}
+
+static void testSpikeLoad(void) {
+    LockstepRecord_t record;
+    TEST_ASSERT_EQUAL_INT(LOCKSTEP_FORMAT_SPIKE,
+                          parseSpike("core   0: 3 0x80000014 (0x00002303) x6  0x00000005 mem 0x80001000", &record));
+    TEST_ASSERT_EQUAL_UINT8(1, record.hasrd);
+    TEST_ASSERT_EQUAL_UINT8(6, record.rdnum);
+    TEST_ASSERT_EQUAL_HEX32(0x00000005, record.rd);
+    TEST_ASSERT_EQUAL_UINT8(0, record.hasstore);
+}
+
+static void testSpikeCsrSkipped(void) {
+    LockstepRecord_t record;
+    TEST_ASSERT_EQUAL_INT(LOCKSTEP_FORMAT_SPIKE,
+                          parseSpike("core   0: 3 0x80000018 (0x30529073) c773_mtvec 0x80000100", &record));
+    TEST_ASSERT_EQUAL_UINT8(0, record.hasrd);
+    TEST_ASSERT_EQUAL_UINT8(0, record.hasstore);
+}
+
+static void testSpikeWithoutPrivilege(void) {
+    // A -l line, not a commit.
+    LockstepRecord_t record;
+    TEST_ASSERT_EQUAL_INT(LOCKSTEP_FORMAT_NONE,
+                          parseSpike("core   0: 0x0000000000001000 (0x00000297) auipc   t0, 0x0", &record));
+}
+
+static void testSailStart(void) {
+    uint32_t programcounter = 0;
+    const char *writes = NULL;
+    TEST_ASSERT_EQUAL_INT(LOCKSTEP_FORMAT_SAIL,
+                          LockstepParseStart("[0] [M]: 0x0000000080000000 (0x00000297) auipc t0, 0", &programcounter, &writes));
+    TEST_ASSERT_EQUAL_HEX32(0x80000000, programcounter);
+    TEST_ASSERT_EQUAL_INT(LOCKSTEP_FORMAT_NONE, LockstepParseStart("x5 <- 0x80000000", &programcounter, &writes));
+}
+
+static void testSailRegisterWrite(void) {
+    LockstepRecord_t record = {0};
+    LockstepParseSailWrite("x5 <- 0x0000000080000000", &record);
+    TEST_ASSERT_EQUAL_UINT8(1, record.hasrd);
+    TEST_ASSERT_EQUAL_UINT8(5, record.rdnum);
+    TEST_ASSERT_EQUAL_HEX32(0x80000000, record.rd);
+
+    // Writes to x0 are not retired.
+    LockstepRecord_t zero = {0};
+    LockstepParseSailWrite("x0 <- 0x0000000000000001", &zero);
+    TEST_ASSERT_EQUAL_UINT8(0, zero.hasrd);
+}
+
+static void testSailStore(void) {
+    LockstepRecord_t record = {0};
+    LockstepParseSailWrite("mem[0x0000000080001000] <- 0x05", &record);
+    TEST_ASSERT_EQUAL_UINT8(1, record.hasstore);
+    TEST_ASSERT_EQUAL_HEX32(0x80001000, record.memorylocation);
+    TEST_ASSERT_EQUAL_HEX32(0x00000005, record.value);
+}
+
+static void testSailStoreWithKind(void) {
+    LockstepRecord_t record = {0};
+    LockstepParseSailWrite("mem[W,0x80001004] <- 0x12345678", &record);
+    TEST_ASSERT_EQUAL_UINT8(1, record.hasstore);
+    TEST_ASSERT_EQUAL_HEX32(0x80001004, record.memorylocation);
+    TEST_ASSERT_EQUAL_HEX32(0x12345678, record.value);
+}
+
+static void testSailLoad(void) {
+    // A load reads, it writes nothing but its register.
+    LockstepRecord_t record = {0};
+    LockstepParseSailWrite("mem[R,0x80001000] -> 0x05", &record);
+    LockstepParseSailWrite("x6 <- 0x0000000000000005", &record);
+    TEST_ASSERT_EQUAL_UINT8(0, record.hasstore);
+    TEST_ASSERT_EQUAL_UINT8(1, record.hasrd);
+    TEST_ASSERT_EQUAL_UINT8(6, record.rdnum);
+    TEST_ASSERT_EQUAL_HEX32(0x00000005, record.rd);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(testSpikeRegisterWrite);
+    RUN_TEST(testSpikeSignExtended);
+    RUN_TEST(testSpikeStore);
+    RUN_TEST(testSpikeLoad);
+    RUN_TEST(testSpikeCsrSkipped);
+    RUN_TEST(testSpikeWithoutPrivilege);
+    RUN_TEST(testSailStart);
+    RUN_TEST(testSailRegisterWrite);
+    RUN_TEST(testSailStore);
+    RUN_TEST(testSailStoreWithKind);
+    RUN_TEST(testSailLoad);
+    return UNITY_END();
+}